@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "args.h"
+#include "mandelbrot.h"
 #include "options.h"
 #include "types.h"
 
@@ -75,6 +76,49 @@ static void read_bounds(int param_num, int argc, char* argv[])
 	options_setBounds(b);
 }
 
+/* Lit les canaux supplémentaires : d (distance), t (piège), s (stripes),
+   i (itérations) */
+static void read_channels(int param_num, int argc, char* argv[])
+{
+	const char *c = read_string(param_num, param_num+1, argc, argv);
+	int mask = 0;
+	for (; *c != '\0'; ++c) {
+		if (*c == 'd') {
+			mask |= MANDELBROT_CHANNEL_DISTANCE;
+		} else if (*c == 't') {
+			mask |= MANDELBROT_CHANNEL_TRAP;
+		} else if (*c == 's') {
+			mask |= MANDELBROT_CHANNEL_STRIPE;
+		} else if (*c == 'i') {
+			mask |= MANDELBROT_CHANNEL_ITERATIONS;
+		} else {
+			printf("\nCanal inconnu : '%c'\n", *c);
+			exit(EXIT_FAILURE);
+		}
+	}
+	options_setChannels(mask);
+}
+
+/* Lit la formule (et l'exposant de zn), renvoie le nombre d'arguments lus */
+static int read_formula(int param_num, int argc, char* argv[])
+{
+	const char *names[MANDELBROT_NBFORMULAS] = MANDELBROT_FORMULA_NAMES;
+	const char *name = read_string(param_num, param_num+1, argc, argv);
+	int f;
+	for (f = 0; f < MANDELBROT_NBFORMULAS; ++f)
+		if (strcmp(name, names[f]) == 0)
+			break;
+	if (f == MANDELBROT_NBFORMULAS) {
+		printf("\nFormule inconnue : \"%s\"\n", name);
+		exit(EXIT_FAILURE);
+	}
+	options_setFormula(f);
+	if (f != MANDELBROT_FORMULA_ZN)
+		return 1;
+	options_setPower(read_integer(param_num, param_num+2, argc, argv));
+	return 2;
+}
+
 void args_read(int argc, char *argv[])
 {
 	int i = 1;
@@ -110,6 +154,45 @@ void args_read(int argc, char *argv[])
 			++i;
 			options_setCaptureNbFrames(read_integer(i, i+1, argc, argv));
 			++i;
+		} else if (strcmp(argv[i], "--fps") == 0) {
+			options_setFps(read_double(i, i+1, argc, argv));
+			++i;
+		} else if (strcmp(argv[i], "--batch") == 0) {
+			options_setBatchFile(read_string(i, i+1, argc, argv));
+			++i;
+		} else if (strcmp(argv[i], "--formula") == 0) {
+			i += read_formula(i, argc, argv);
+		} else if (strcmp(argv[i], "--equalize") == 0) {
+			options_setEqualize(1);
+		} else if (strcmp(argv[i], "--predict") == 0) {
+			options_setPredict(1);
+		} else if (strcmp(argv[i], "--preview") == 0) {
+			options_setPreview(1);
+		} else if (strcmp(argv[i], "--symmetry") == 0) {
+			options_setSymmetry(read_double(i, i+1, argc, argv));
+			++i;
+		} else if (strcmp(argv[i], "--channels") == 0) {
+			read_channels(i, argc, argv);
+			++i;
+		} else if (strcmp(argv[i], "--server") == 0) {
+			options_setServerAddress(read_string(i, i+1, argc, argv));
+			++i;
+		} else if (strcmp(argv[i], "--buddhabrot") == 0) {
+			options_setBuddhabrot(read_integer(i, i+1, argc, argv));
+			++i;
+		} else if (strcmp(argv[i], "--sweep") == 0) {
+			options_setSweepPath(read_string(i, i+1, argc, argv));
+			++i;
+			options_setSweepNbFrames(read_integer(i, i+1, argc, argv));
+			++i;
+		} else if (strcmp(argv[i], "--atlas") == 0) {
+			options_setAtlas(read_integer(i, i+1, argc, argv), 
+					read_integer(i, i+2, argc, argv), read_integer(i, i+3, argc, argv));
+			i += 3;
+		} else if (strcmp(argv[i], "--tiles") == 0) {
+			options_setTilesMode(1);
+			options_setTilesMaxZoom(read_integer(i, i+1, argc, argv));
+			++i;
 		} else {
 			printf("\nParamètre inconnu : \"%s\"\n", argv[i]);
 			exit(EXIT_FAILURE);
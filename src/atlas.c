@@ -0,0 +1,268 @@
+#include <math.h>
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "atlas.h"
+#include "mandelbrot.h"
+
+#define COLOR_DEPTH 32                // couleurs 32 bits
+#define MICROSEC_IN_A_SEC 1000000
+#define LOG_2 0.693147181
+// points calculés ensemble : voies d'un registre vectoriel de doubles
+#ifdef __AVX__
+#define ATLAS_LANES 4
+#else
+#define ATLAS_LANES 2                 // SSE2, NEON
+#endif
+
+/* Atlas en cours de calcul. Une tâche calcule une ligne de pixels de 
+   l'atlas, qui traverse une ligne de vignettes de la grille */
+struct atlas {
+	struct complex *seeds;        // c des vignettes
+	int nbSeeds;                  // nombre de vignettes
+	int cols, size;               // vignettes par ligne, côté d'une vignette
+	int width;                    // largeur de l'atlas (pixels)
+	int nbMaxIt;
+	double *xPoints;              // partie réelle des points d'une ligne
+	double incr;                  // distance entre deux pixels d'une vignette
+	float *values;                // nombre d'itérations lissé de chaque pixel
+};
+
+/*********************************************/
+/*******             CALCUL        ***********/
+/*********************************************/
+
+/* Nombre d'itérations lissé d'un point s'échappant en it itérations (ou 
+   resté borné, it valant alors nbMaxIt), calculé comme par le moteur */
+static float smooth_value(int it, int nbMaxIt, double zr, double zi)
+{
+	double smooth = nbMaxIt;
+	if (it < nbMaxIt)
+		smooth = it - (log(0.5*log(zr*zr + zi*zi))/LOG_2);
+	return (float) ((smooth<0.0)?0.0:smooth);
+}
+
+#ifdef __GNUC__
+/* Voies des registres vectoriels (extensions vectorielles de GCC) : une
+   comparaison donne -1 (tous les bits à 1) dans les voies où elle est vraie */
+typedef double lanes_d __attribute__((vector_size(ATLAS_LANES * sizeof(double))));
+typedef long long lanes_l __attribute__((vector_size(ATLAS_LANES * sizeof(long long))));
+
+/* Itère z -> z^2 + c au plus steps fois dans les voies des deux vecteurs
+   (chaînes de calcul indépendantes, exécutées en parallèle par le 
+   processeur), jusqu'à ce qu'un point s'échappe. Les carrés des parties de
+   z, calculés pour le module, servent à l'itération suivante. Les voies 
+   restent dans les registres pendant la boucle. Renvoie le nombre 
+   d'itérations faites */
+static int iterate(lanes_d *zr, lanes_d *zi, lanes_d *zr2, lanes_d *zi2,
+		const lanes_d *cr, const lanes_d *ci, int steps)
+{
+	const lanes_d four = cr[0]*0 + 4;
+	lanes_d zr0 = zr[0], zi0 = zi[0], zr20 = zr2[0], zi20 = zi2[0], cr0 = cr[0], ci0 = ci[0];
+	lanes_d zr1 = zr[1], zi1 = zi[1], zr21 = zr2[1], zi21 = zi2[1], cr1 = cr[1], ci1 = ci[1];
+	lanes_l escaped;
+	long long any;
+	int k = 0, l;
+	do {
+		zi0 = 2*zr0*zi0 + ci0;
+		zr0 = zr20 - zi20 + cr0;
+		zi1 = 2*zr1*zi1 + ci1;
+		zr1 = zr21 - zi21 + cr1;
+		zr20 = zr0*zr0; zi20 = zi0*zi0;
+		zr21 = zr1*zr1; zi21 = zi1*zi1;
+		escaped = (zr20 + zi20 > four) | (zr21 + zi21 > four);
+		for (l = 0, any = 0; l < ATLAS_LANES; ++l)
+			any |= escaped[l];
+	} while (++k < steps && !any);
+	zr[0] = zr0; zi[0] = zi0; zr2[0] = zr20; zi2[0] = zi20;
+	zr[1] = zr1; zi[1] = zi1; zr2[1] = zr21; zi2[1] = zi21;
+	return k;
+}
+
+/* Calcule la ligne task de l'atlas (formule z2, Julia). Les pixels de la 
+   ligne sont pris en alternant les vignettes (pixel x de chaque vignette, 
+   puis x+1...) et itérés par 2*ATLAS_LANES à la fois, un par voie : les 
+   voies portent ainsi des points de c différents. Dès qu'un point s'échappe
+   ou atteint nbMaxIt, sa voie reçoit le pixel suivant : aucune voie 
+   n'attend la plus lente, quelles que soient les divergences entre 
+   vignettes. La boucle d'itération s'arrête au plus tôt quand la voie la 
+   plus avancée atteint nbMaxIt, et n'a donc qu'à tester l'échappement */
+static void row_task(int task, void *data)
+{
+	const struct atlas *a = (const struct atlas*) data;
+	const int r = task / a->size, y = task % a->size;
+	const int first = r*a->cols;   // première vignette de la ligne
+	const int nbCols = (a->nbSeeds - first < a->cols) ? a->nbSeeds - first : a->cols;
+	const double yPoint = -MANDELBROT_JULIA_EXTENT + y*a->incr;
+	float *row = a->values + task*a->width;
+	lanes_d zr[2] = {{0}}, zi[2] = {{0}}, zr2[2] = {{0}}, zi2[2] = {{0}};
+	lanes_d cr[2] = {{0}}, ci[2] = {{0}};
+	int count[2][ATLAS_LANES];       // itérations faites dans chaque voie
+	int dest[2][ATLAS_LANES];        // pixel de chaque voie dans row, -1 : libre
+	int v, l, steps, escaped, col = 0, x = 0, busy = 0;
+
+	for (v = 0; v < 2; ++v)
+		for (l = 0; l < ATLAS_LANES; ++l) {
+			count[v][l] = a->nbMaxIt;  // chargement initial des voies
+			dest[v][l] = -1;
+		}
+	while (1) {
+		steps = a->nbMaxIt;
+		for (v = 0; v < 2; ++v)
+			for (l = 0; l < ATLAS_LANES; ++l) {
+				escaped = (zr2[v][l] + zi2[v][l] > 4);
+				if (!escaped && count[v][l] < a->nbMaxIt) {
+					steps = (a->nbMaxIt - count[v][l] < steps) ? a->nbMaxIt - count[v][l] : steps;
+					continue;
+				}
+				if (dest[v][l] >= 0) {
+					// un point échappé a fait une itération de plus que it
+					row[dest[v][l]] = smooth_value(count[v][l] - escaped,
+							a->nbMaxIt, zr[v][l], zi[v][l]);
+					--busy;
+				}
+				if (x < a->size) {
+					// pixel suivant : même x dans la vignette suivante
+					dest[v][l] = col*a->size + x;
+					zr[v][l] = a->xPoints[x];
+					zi[v][l] = yPoint;
+					cr[v][l] = a->seeds[first + col].real;
+					ci[v][l] = a->seeds[first + col].im;
+					++busy;
+					if (++col == nbCols) {
+						col = 0;
+						++x;
+					}
+				} else {
+					dest[v][l] = -1;  // plus de pixel : la voie tourne à vide
+					zr[v][l] = zi[v][l] = cr[v][l] = ci[v][l] = 0;
+				}
+				zr2[v][l] = zr[v][l]*zr[v][l];
+				zi2[v][l] = zi[v][l]*zi[v][l];
+				count[v][l] = 0;
+			}
+		if (busy == 0)
+			break;
+		steps = iterate(zr, zi, zr2, zi2, cr, ci, steps);
+		for (v = 0; v < 2; ++v)
+			for (l = 0; l < ATLAS_LANES; ++l)
+				count[v][l] += steps;
+	}
+}
+#else
+/* Calcule la ligne task de l'atlas (formule z2, Julia), un pixel après 
+   l'autre à défaut d'extensions vectorielles */
+static void row_task(int task, void *data)
+{
+	const struct atlas *a = (const struct atlas*) data;
+	const int r = task / a->size, y = task % a->size;
+	const double yPoint = -MANDELBROT_JULIA_EXTENT + y*a->incr;
+	float *row = a->values + task*a->width;
+	struct complex c;
+	double zr, zi, newReal;
+	int col, x, it;
+	for (col = 0; col < a->cols && r*a->cols + col < a->nbSeeds; ++col) {
+		c = a->seeds[r*a->cols + col];
+		for (x = 0; x < a->size; ++x) {
+			zr = a->xPoints[x];
+			zi = yPoint;
+			it = 0;
+			do {
+				newReal = zr*zr - zi*zi + c.real;
+				zi = 2*zr*zi + c.im;
+				zr = newReal;
+			} while (zr*zr + zi*zi <= 4 && ++it < a->nbMaxIt);
+			row[col*a->size + x] = smooth_value(it, a->nbMaxIt, zr, zi);
+		}
+	}
+}
+#endif
+
+/*********************************************/
+/*******          SAUVEGARDE       ***********/
+/*********************************************/
+
+/* Ecrit l'index de l'atlas : position (cellule et pixel du coin supérieur
+   gauche) et c de chaque vignette */
+static void save_index(const char *fileName, const struct atlas *a, int rows)
+{
+	FILE *file = fopen(fileName, "w");
+	int s;
+	if (file == NULL) {
+		printf("\nImpossible d'écrire \"%s\"\n", fileName); exit(EXIT_FAILURE);
+	}
+	fprintf(file, "# atlas %d x %d vignettes de %d x %d pixels, nbMaxIt %d\n",
+			a->cols, rows, a->size, a->size, a->nbMaxIt);
+	fprintf(file, "# colonne ligne x y re im\n");
+	for (s = 0; s < a->nbSeeds; ++s)
+		fprintf(file, "%d %d %d %d %.17g %.17g\n", s % a->cols, s / a->cols,
+				(s % a->cols)*a->size, (s / a->cols)*a->size,
+				a->seeds[s].real, a->seeds[s].im);
+	fclose(file);
+}
+
+/*********************************************/
+/*******       PUBLIC FUNCTIONS    ***********/
+/*********************************************/
+
+void atlas_run(struct bounds _bounds, int cols, int rows, int size,
+		int _nbMaxIt, int equalize, const char *name)
+{
+	char fileName[1024+8];
+	struct atlas a;
+	struct mandelbrot_job job;
+	struct timeval start, end;
+	SDL_Surface *s;
+	int i;
+
+	a.nbSeeds = cols*rows;
+	a.cols = cols;
+	a.size = size;
+	a.width = cols*size;
+	a.nbMaxIt = _nbMaxIt;
+	a.seeds = (struct complex*) malloc(a.nbSeeds * sizeof(struct complex));
+	for (i = 0; i < a.nbSeeds; ++i) {
+		a.seeds[i].real = _bounds.xmin + (i % cols + 0.5) * (_bounds.xmax - _bounds.xmin) / cols;
+		a.seeds[i].im = _bounds.ymin + (i / cols + 0.5) * (_bounds.ymax - _bounds.ymin) / rows;
+	}
+	// points cumulés comme par le moteur (mêmes arrondis)
+	a.incr = (MANDELBROT_JULIA_EXTENT - (-MANDELBROT_JULIA_EXTENT)) / size;
+	a.xPoints = (double*) malloc(size * sizeof(double));
+	for (i = 0; i < size; ++i)
+		a.xPoints[i] = (i == 0) ? -MANDELBROT_JULIA_EXTENT : a.xPoints[i-1] + a.incr;
+	a.values = (float*) malloc(a.width * rows*size * sizeof(float));
+	s = SDL_CreateRGBSurface(0, a.width, rows*size, COLOR_DEPTH, 0, 0, 0, 0);
+	if (a.values == NULL || s == NULL) {
+		printf("\nImpossible d'obtenir une surface graphique\n"); exit(EXIT_FAILURE);
+	}
+
+	// une tâche par ligne de l'atlas : les vignettes de toute la grille sont
+	// réparties ensemble sur les threads
+	mandelbrot_setDisplay(0);
+	gettimeofday(&start, NULL);
+	mandelbrot_parallel(rows*size, row_task, &a);
+	// coloration par le moteur, comme celle d'un rendu de l'atlas entier
+	mandelbrot_initJob(&job, _bounds, a.seeds[0], 1, _nbMaxIt, s);
+	job.channels[MANDELBROT_INDEX_ITERATIONS] = a.values;
+	mandelbrot_colorize(&job, equalize ? MANDELBROT_COLORING_EQUALIZED
+			: MANDELBROT_COLORING_LINEAR, s);
+	gettimeofday(&end, NULL);
+	printf("\rAtlas de %d ensembles calculé en %2.3f secondes! ", a.nbSeeds,
+			(end.tv_sec - start.tv_sec)
+			+ (double) (end.tv_usec - start.tv_usec) / MICROSEC_IN_A_SEC);
+	fflush(stdout);
+	mandelbrot_setDisplay(1);
+
+	sprintf(fileName, "%s.bmp", name);
+	SDL_SaveBMP(s, fileName);
+	sprintf(fileName, "%s.txt", name);
+	save_index(fileName, &a, rows);
+
+	SDL_FreeSurface(s);
+	free(a.values);
+	free(a.xPoints);
+	free(a.seeds);
+}
@@ -0,0 +1,23 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "types.h"
+
+/* Mode atlas : planche de vignettes des ensembles de Julia d'une grille de
+   valeurs de c, rendues ensemble en un seul calcul */
+
+/* Rend les cols*rows ensembles de Julia (formule z^2 + c) dont les c sont
+   les centres des cellules d'une grille de cols x rows sur _bounds.
+   Chaque vignette, de size x size pixels, montre le carré de demi-largeur
+   MANDELBROT_JULIA_EXTENT autour de 0 ; elle est placée dans l'atlas comme 
+   sa cellule dans la grille (c croissant vers la droite et vers le bas).
+   - name : l'atlas est sauvegardé dans name.bmp, son index (position et c
+     de chaque vignette) dans name.txt
+   - equalize : coloration par égalisation d'histogramme sur tout l'atlas
+   Les lignes de l'atlas sont réparties sur les threads et les points de 
+   plusieurs vignettes itérés ensemble, un par voie des registres vectoriels.
+   Le moteur doit être initialisé (mandelbrot_init) */
+void atlas_run(struct bounds _bounds, int cols, int rows, int size,
+		int _nbMaxIt, int equalize, const char *name);
+
+#endif
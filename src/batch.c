@@ -0,0 +1,129 @@
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "mandelbrot.h"
+#include "options.h"
+
+#define COLOR_DEPTH 32                // couleurs 32 bits
+#define BATCH_GROUP_MAX 16            // nombre max de vues rendues ensemble
+#define BATCH_GROUP_PIXELS (512*512)  // au delà, une vue est rendue seule
+#define LINE_MAX_LENGTH 2048
+
+/*********************************************/
+/*******    VARIABLES DU MODULE    ***********/
+/*********************************************/
+
+/* Groupe de vues en attente de rendu */
+static struct mandelbrot_job jobs[BATCH_GROUP_MAX];
+static char names[BATCH_GROUP_MAX][LINE_MAX_LENGTH];
+static int nbJobs, nbPixels;
+
+/* Surfaces réutilisées d'un groupe à l'autre (une par vue du groupe) */
+static SDL_Surface *surfaces[BATCH_GROUP_MAX];
+
+static int nbRendered;
+
+/*********************************************/
+/*******          UTILITAIRES      ***********/
+/*********************************************/
+
+/* Renvoie une surface w*h pour la vue i du groupe, réallouée si besoin */
+static SDL_Surface *get_surface(int i, int w, int h)
+{
+	if (surfaces[i] != NULL && surfaces[i]->w == w && surfaces[i]->h == h)
+		return surfaces[i];
+	SDL_FreeSurface(surfaces[i]);
+	surfaces[i] = SDL_CreateRGBSurface(0, w, h, COLOR_DEPTH, 0, 0, 0, 0);
+	if (surfaces[i] == NULL) {
+		printf("\nImpossible d'obtenir une surface graphique\n"); exit(EXIT_FAILURE);
+	}
+	return surfaces[i];
+}
+
+/* Rend et sauvegarde le groupe courant */
+static void flush()
+{
+	char name[LINE_MAX_LENGTH+8];
+	int i;
+	if (nbJobs == 0)
+		return;
+	mandelbrot_renderJobs(jobs, nbJobs);
+	for (i = 0; i < nbJobs; ++i) {
+		sprintf(name, "%s.bmp", names[i]);
+		SDL_SaveBMP(jobs[i].surface, name);
+	}
+	nbRendered += nbJobs;
+	printf("\r%d images générées    ", nbRendered);
+	fflush(stdout);
+	nbJobs = nbPixels = 0;
+}
+
+/* Lit une vue, renvoie 0 si la ligne est incorrecte */
+static int read_view(const char *line, char *name, struct mandelbrot_job *job,
+		int *w, int *h)
+{
+	struct bounds b;
+	struct complex init;
+	int julia, nbMaxIt;
+	if (sscanf(line, "%s %d %d %lf %lf %lf %lf %lf %lf %d %d", name, w, h,
+				&b.xmin, &b.xmax, &b.ymin, &b.ymax, &init.real, &init.im,
+				&julia, &nbMaxIt) != 11)
+		return 0;
+	mandelbrot_initJob(job, b, init, julia, nbMaxIt, NULL);
+	job->formula = options_getFormula();
+	job->power = options_getPower();
+	job->symmetry = options_getSymmetry();
+	return *w > 0 && *h > 0 && b.xmin < b.xmax && b.ymin < b.ymax
+		&& nbMaxIt >= NBMAXIT_MIN;
+}
+
+/*********************************************/
+/*******       PUBLIC FUNCTIONS    ***********/
+/*********************************************/
+
+void batch_run(const char *fileName)
+{
+	char line[LINE_MAX_LENGTH], name[LINE_MAX_LENGTH];
+	struct mandelbrot_job job;
+	int w, h, lineNum = 0;
+	FILE *file;
+
+	if (strcmp(fileName, "-") == 0) {
+		file = stdin;
+	} else if ((file = fopen(fileName, "r")) == NULL) {
+		printf("\nImpossible d'ouvrir le fichier \"%s\"\n", fileName); exit(EXIT_FAILURE);
+	}
+
+	mandelbrot_setDisplay(0);
+	nbJobs = nbPixels = nbRendered = 0;
+	while (fgets(line, LINE_MAX_LENGTH, file) != NULL) {
+		++lineNum;
+		if (line[strspn(line, " \t\r\n")] == '\0' || line[0] == '#')
+			continue;
+		if (!read_view(line, name, &job, &w, &h)) {
+			printf("\nLigne %d incorrecte, ignorée\n", lineNum);
+			continue;
+		}
+		// une grande vue n'est pas regroupée avec les précédentes
+		if (nbPixels + w*h > BATCH_GROUP_PIXELS)
+			flush();
+		strcpy(names[nbJobs], name);
+		job.surface = get_surface(nbJobs, w, h);
+		jobs[nbJobs++] = job;
+		nbPixels += w*h;
+		if (nbJobs == BATCH_GROUP_MAX)
+			flush();
+	}
+	flush();
+	mandelbrot_setDisplay(1);
+
+	if (file != stdin)
+		fclose(file);
+	for (w = 0; w < BATCH_GROUP_MAX; ++w) {
+		SDL_FreeSurface(surfaces[w]);
+		surfaces[w] = NULL;
+	}
+}
@@ -0,0 +1,14 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/* Mode batch : rendu de nombreuses vues dans un seul processus */
+
+/* Lit les vues du fichier fileName ("-" pour l'entrée standard) et les rend
+   une à une, ou plusieurs à la fois lorsqu'elles sont petites. Une ligne décrit
+   une vue (les lignes vides ou commençant par # sont ignorées) :
+   nom largeur hauteur xmin xmax ymin ymax initRe initIm julia nbMaxIt
+   Le rendu est sauvegardé dans nom.bmp.
+   Le moteur doit être initialisé (mandelbrot_init) */
+void batch_run(const char *fileName);
+
+#endif
@@ -0,0 +1,373 @@
+#include <math.h>
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buddhabrot.h"
+#include "mandelbrot.h"
+
+#define COLOR_DEPTH 32                // couleurs 32 bits
+#define NBBANDS 3                     // rouge, vert, bleu
+#define PASS_SAMPLES 1000000          // tirages par passe (entre deux sauvegardes)
+#define SAMPLE_RADIUS 2.0             // les c tirés sont dans [-2,2]x[-2,2]
+#define GRID_SIZE 256                 // grille d'importance : GRID_SIZE^2 cellules
+#define GRID_SUBSAMPLES 4             // points testés par côté de cellule
+#define GRID_MIN_ESCAPE 5             // en deçà, orbite jugée trop courte
+#define CHECKPOINT_MAGIC "MANDELBUDDHA2"  // 2 : passes d'un million de tirages
+
+/*********************************************/
+/*******    VARIABLES DU MODULE    ***********/
+/*********************************************/
+
+/* Paramètres du rendu */
+static struct bounds bounds;
+static struct complex init;           // z0
+static int nbMaxIt;
+static struct dimension dim;
+static int limits[NBBANDS];           // itérations max des orbites de chaque bande
+static double xScale, yScale;         // pixels par unité de l'espace
+
+/* Histogrammes : un privé par tâche (pas de conflit d'écriture entre
+   threads) fusionnés après chaque passe dans total. Les bandes d'un pixel
+   sont contigües : (y*largeur + x)*NBBANDS + bande */
+static int nbTasks;
+static Uint32 **histograms;
+static unsigned long long *total;
+static struct complex **orbits;       // orbite courante de chaque tâche
+static long long pass;                // passe en cours (graine des tirages)
+
+/* Grille d'importance : cellules proches du bord de l'ensemble */
+static int *cells;
+static int nbCells;
+static char *useful;
+
+/* Sauvegarde de la progression */
+struct checkpoint {
+	char magic[16];
+	int width, height, nbMaxIt;
+	struct bounds bounds;
+	struct complex init;
+	long long passes;                 // nombre de passes terminées
+};
+
+/*********************************************/
+/*******          UTILITAIRES      ***********/
+/*********************************************/
+
+/* Générateur pseudo-aléatoire (splitmix64), un état par tâche */
+static unsigned long long next_random(unsigned long long *state)
+{
+	unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/* Réel uniforme dans [0, 1[ */
+static double random_double(unsigned long long *state)
+{
+	return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Itère depuis init pour c, renvoie le nombre d'itérations avant
+   échappement (nbMaxIt si l'orbite reste bornée). Si orbit n'est pas NULL,
+   les points de l'orbite y sont enregistrés */
+static int escape(struct complex c, struct complex *orbit)
+{
+	struct complex z = init;
+	double newReal;
+	int it;
+	for (it = 0; it < nbMaxIt; ++it) {
+		newReal = z.real*z.real - z.im*z.im + c.real;
+		z.im = 2*z.real*z.im + c.im;
+		z.real = newReal;
+		if (orbit != NULL)
+			orbit[it] = z;
+		if (z.real*z.real + z.im*z.im > 4)
+			return it;
+	}
+	return nbMaxIt;
+}
+
+/*********************************************/
+/*******     GRILLE D'IMPORTANCE   ***********/
+/*********************************************/
+
+/* Classe une ligne de cellules : une cellule est utile si elle contient des
+   orbites qui s'échappent tard ou à la fois des orbites bornées et non
+   bornées. Les cellules intérieures n'apportent rien, les cellules
+   lointaines des orbites de quelques points seulement */
+static void classify_task(int j, void *data)
+{
+	const double cellSize = 2*SAMPLE_RADIUS / GRID_SIZE;
+	struct complex c;
+	int i, sx, sy, it, escaped, bounded, deep;
+	for (i = 0; i < GRID_SIZE; ++i) {
+		escaped = bounded = deep = 0;
+		for (sy = 0; sy < GRID_SUBSAMPLES; ++sy)
+			for (sx = 0; sx < GRID_SUBSAMPLES; ++sx) {
+				c.real = -SAMPLE_RADIUS + (i + (sx + 0.5)/GRID_SUBSAMPLES)*cellSize;
+				c.im = -SAMPLE_RADIUS + (j + (sy + 0.5)/GRID_SUBSAMPLES)*cellSize;
+				it = escape(c, NULL);
+				if (it == nbMaxIt) {
+					bounded = 1;
+				} else {
+					escaped = 1;
+					deep |= (it >= GRID_MIN_ESCAPE);
+				}
+			}
+		useful[j*GRID_SIZE + i] = escaped && (bounded || deep);
+	}
+}
+
+/* Construit la liste des cellules utiles, étendue à leurs voisines pour ne
+   pas manquer les zones fines que les points testés n'ont pas vues */
+static void build_grid()
+{
+	int i, j, di, dj, keep;
+	useful = (char*) malloc(GRID_SIZE*GRID_SIZE);
+	cells = (int*) malloc(GRID_SIZE*GRID_SIZE * sizeof(int));
+	if (useful == NULL || cells == NULL) {
+		printf("\nMémoire insuffisante\n"); exit(EXIT_FAILURE);
+	}
+	mandelbrot_parallel(GRID_SIZE, classify_task, NULL);
+	nbCells = 0;
+	for (j = 0; j < GRID_SIZE; ++j)
+		for (i = 0; i < GRID_SIZE; ++i) {
+			keep = 0;
+			for (dj = -1; dj <= 1; ++dj)
+				for (di = -1; di <= 1; ++di)
+					if (i+di >= 0 && i+di < GRID_SIZE && j+dj >= 0 && j+dj < GRID_SIZE)
+						keep |= useful[(j+dj)*GRID_SIZE + i+di];
+			if (keep)
+				cells[nbCells++] = j*GRID_SIZE + i;
+		}
+	free(useful);
+}
+
+/*********************************************/
+/*******        ACCUMULATION       ***********/
+/*********************************************/
+
+/* Tire la part de la tâche des PASS_SAMPLES points c de la passe dans les 
+   cellules utiles et accumule les orbites qui s'échappent dans l'histogramme
+   privé de la tâche */
+static void sample_task(int task, void *data)
+{
+	const double cellSize = 2*SAMPLE_RADIUS / GRID_SIZE;
+	const int nbSamples = (int) ((long long) PASS_SAMPLES*(task+1)/nbTasks 
+			- (long long) PASS_SAMPLES*task/nbTasks);
+	unsigned long long state = (unsigned long long) pass * nbTasks + task;
+	Uint32 *histogram = histograms[task];
+	struct complex *orbit = orbits[task];
+	struct complex c;
+	int s, k, b, it, cell, x, y;
+	Uint32 *bin;
+
+	memset(histogram, 0, dim.width*dim.height*NBBANDS * sizeof(Uint32));
+	for (s = 0; s < nbSamples; ++s) {
+		cell = cells[next_random(&state) % nbCells];
+		c.real = -SAMPLE_RADIUS + (cell % GRID_SIZE + random_double(&state))*cellSize;
+		c.im = -SAMPLE_RADIUS + (cell / GRID_SIZE + random_double(&state))*cellSize;
+		it = escape(c, orbit);
+		if (it == nbMaxIt)
+			continue;
+		for (k = 0; k < it; ++k) {
+			x = (int) floor((orbit[k].real - bounds.xmin) * xScale);
+			y = (int) floor((orbit[k].im - bounds.ymin) * yScale);
+			if (x < 0 || x >= dim.width || y < 0 || y >= dim.height)
+				continue;
+			bin = histogram + (y*dim.width + x)*NBBANDS;
+			for (b = 0; b < NBBANDS && it < limits[b]; ++b)
+				++bin[b];
+		}
+	}
+}
+
+/* Réduction : la tâche somme les histogrammes privés sur sa part des cases */
+static void merge_task(int task, void *data)
+{
+	const long size = (long) dim.width*dim.height*NBBANDS;
+	const long first = size * task / nbTasks;
+	const long last = size * (task+1) / nbTasks;
+	long i;
+	int k;
+	for (k = 0; k < nbTasks; ++k)
+		for (i = first; i < last; ++i)
+			total[i] += histograms[k][i];
+}
+
+/*********************************************/
+/*******    SAUVEGARDE / REPRISE   ***********/
+/*********************************************/
+
+static void fill_checkpoint(struct checkpoint *ckpt, long long passes)
+{
+	memset(ckpt, 0, sizeof(*ckpt));
+	strcpy(ckpt->magic, CHECKPOINT_MAGIC);
+	ckpt->width = dim.width;
+	ckpt->height = dim.height;
+	ckpt->nbMaxIt = nbMaxIt;
+	ckpt->bounds = bounds;
+	ckpt->init = init;
+	ckpt->passes = passes;
+}
+
+/* Recharge la progression, renvoie le nombre de passes déjà réalisées */
+static long long load_checkpoint(const char *name)
+{
+	struct checkpoint expected, ckpt;
+	const size_t size = (size_t) dim.width*dim.height*NBBANDS;
+	FILE *file = fopen(name, "rb");
+	if (file == NULL)
+		return 0;
+	fill_checkpoint(&expected, 0);
+	if (fread(&ckpt, sizeof(ckpt), 1, file) != 1) {
+		fclose(file);
+		return 0;
+	}
+	expected.passes = ckpt.passes;
+	if (memcmp(&ckpt, &expected, sizeof(ckpt)) != 0
+			|| fread(total, sizeof(unsigned long long), size, file) != size) {
+		printf("\nSauvegarde \"%s\" incompatible, rendu repris à zéro\n", name);
+		memset(total, 0, size * sizeof(unsigned long long));
+		fclose(file);
+		return 0;
+	}
+	fclose(file);
+	return ckpt.passes;
+}
+
+/* Sauvegarde la progression (fichier temporaire puis renommage : une
+   interruption pendant l'écriture ne corrompt pas la sauvegarde précédente)
+   En cas d'échec de l'écriture (disque plein...), la sauvegarde précédente 
+   est conservée et le rendu continue */
+static void save_checkpoint(const char *name, long long passes)
+{
+	const size_t size = (size_t) dim.width*dim.height*NBBANDS;
+	char tmp[1024+8];
+	struct checkpoint ckpt;
+	FILE *file;
+	int ok;
+	sprintf(tmp, "%s.tmp", name);
+	if ((file = fopen(tmp, "wb")) == NULL) {
+		printf("\nImpossible d'écrire \"%s\"\n", tmp); exit(EXIT_FAILURE);
+	}
+	fill_checkpoint(&ckpt, passes);
+	ok = fwrite(&ckpt, sizeof(ckpt), 1, file) == 1
+		&& fwrite(total, sizeof(unsigned long long), size, file) == size;
+	ok = (fclose(file) == 0) && ok;
+#ifdef WIN32
+	if (ok)
+		remove(name);
+#endif
+	if (!ok || rename(tmp, name) != 0) {
+		remove(tmp);
+		printf("\nEchec de l'écriture de \"%s\", sauvegarde précédente conservée\n", 
+				name);
+	}
+}
+
+/* Sauvegarde l'image : chaque bande est normalisée par son maximum,
+   la racine carrée fait ressortir les zones peu denses */
+static void save_image(const char *name)
+{
+	const long size = (long) dim.width*dim.height;
+	unsigned long long max[NBBANDS] = {1, 1, 1};
+	Uint8 rgb[NBBANDS];
+	Uint32 *pixel;
+	SDL_Surface *s;
+	long i;
+	int b, x, y;
+
+	for (i = 0; i < size; ++i)
+		for (b = 0; b < NBBANDS; ++b)
+			max[b] = (total[i*NBBANDS + b] > max[b]) ? total[i*NBBANDS + b] : max[b];
+
+	s = SDL_CreateRGBSurface(0, dim.width, dim.height, COLOR_DEPTH, 0, 0, 0, 0);
+	if (s == NULL) {
+		printf("\nImpossible d'obtenir une surface graphique\n"); exit(EXIT_FAILURE);
+	}
+	for (y = 0, i = 0; y < dim.height; ++y) {
+		pixel = (Uint32*) s->pixels + y*(s->pitch/4);
+		for (x = 0; x < dim.width; ++x, ++i) {
+			for (b = 0; b < NBBANDS; ++b)
+				rgb[b] = (Uint8) (255 * sqrt((double) total[i*NBBANDS + b] / max[b]));
+			pixel[x] = SDL_MapRGB(s->format, rgb[0], rgb[1], rgb[2]);
+		}
+	}
+	SDL_SaveBMP(s, name);
+	SDL_FreeSurface(s);
+}
+
+/*********************************************/
+/*******       PUBLIC FUNCTIONS    ***********/
+/*********************************************/
+
+void buddhabrot_run(struct bounds _bounds, struct complex _init, int _nbMaxIt,
+		struct dimension _dim, long long nbSamples, const char *name)
+{
+	char ckptName[1024], imageName[1024];
+	const size_t size = (size_t) _dim.width*_dim.height*NBBANDS;
+	long long nbPasses, done;
+	int i;
+
+	bounds = _bounds;
+	init = _init;
+	nbMaxIt = _nbMaxIt;
+	dim = _dim;
+	xScale = dim.width / (bounds.xmax - bounds.xmin);
+	yScale = dim.height / (bounds.ymax - bounds.ymin);
+	limits[0] = nbMaxIt;
+	limits[1] = nbMaxIt / 10;
+	limits[2] = nbMaxIt / 100;
+	sprintf(ckptName, "%s.ckpt", name);
+	sprintf(imageName, "%s.bmp", name);
+
+	nbTasks = mandelbrot_getNbThreads();
+	nbPasses = (nbSamples + PASS_SAMPLES - 1) / PASS_SAMPLES;
+	histograms = (Uint32**) malloc(nbTasks * sizeof(Uint32*));
+	orbits = (struct complex**) malloc(nbTasks * sizeof(struct complex*));
+	total = (unsigned long long*) calloc(size, sizeof(unsigned long long));
+	if (histograms == NULL || orbits == NULL || total == NULL) {
+		printf("\nMémoire insuffisante\n"); exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < nbTasks; ++i) {
+		histograms[i] = (Uint32*) malloc(size * sizeof(Uint32));
+		orbits[i] = (struct complex*) malloc(nbMaxIt * sizeof(struct complex));
+		if (histograms[i] == NULL || orbits[i] == NULL) {
+			printf("\nMémoire insuffisante\n"); exit(EXIT_FAILURE);
+		}
+	}
+
+	mandelbrot_setDisplay(0);
+	done = load_checkpoint(ckptName);
+	if (done > 0)
+		printf("\rReprise après %lld passes    \n", done);
+	build_grid();
+	printf("\rTirages sur %.1f %% de la zone d'échantillonnage\n",
+			100.0 * nbCells / (GRID_SIZE*GRID_SIZE));
+
+	for (pass = done; pass < nbPasses; ++pass) {
+		printf("\rBuddhabrot en cours... %2.1f %%    ", (double) (pass*100)/nbPasses);
+		fflush(stdout);
+		mandelbrot_parallel(nbTasks, sample_task, NULL);
+		mandelbrot_parallel(nbTasks, merge_task, NULL);
+		save_checkpoint(ckptName, pass+1);
+		save_image(imageName);
+	}
+	save_image(imageName);
+	printf("\rBuddhabrot terminé : %lld millions de tirages    ",
+			(nbPasses > done ? nbPasses : done) * PASS_SAMPLES / 1000000);
+	mandelbrot_setDisplay(1);
+
+	for (i = 0; i < nbTasks; ++i) {
+		free(histograms[i]);
+		free(orbits[i]);
+	}
+	free(histograms);
+	free(orbits);
+	free(total);
+	free(cells);
+}
@@ -0,0 +1,22 @@
+#ifndef BUDDHABROT_H
+#define BUDDHABROT_H
+
+#include "types.h"
+
+/* Rendu Buddhabrot / Nebulabrot : densité des orbites qui s'échappent */
+
+/* Tire nbSamples points c, itère z -> z^2 + c depuis z0 = init et accumule
+   les points des orbites qui s'échappent dans un histogramme par canal :
+   rouge, vert et bleu reçoivent les orbites s'échappant en moins de
+   nbMaxIt, nbMaxIt/10 et nbMaxIt/100 itérations.
+   - _bounds, dim : partie du plan affichée et dimension de l'image
+   - name : l'image est sauvegardée dans name.bmp, la progression dans
+     name.ckpt après chaque passe. Un rendu interrompu reprend à la dernière
+     passe sauvegardée si les paramètres sont identiques.
+   Les tirages se concentrent sur les zones proches du bord de l'ensemble,
+   les seules dont les orbites sont longues sans être bornées.
+   Le moteur doit être initialisé (mandelbrot_init) */
+void buddhabrot_run(struct bounds _bounds, struct complex _init, int _nbMaxIt,
+		struct dimension _dim, long long nbSamples, const char *name);
+
+#endif
@@ -0,0 +1,44 @@
+#include "budget.h"
+#include "options.h"
+
+#define BUDGET_SMOOTHING 0.3       // poids d'une nouvelle mesure
+#define BUDGET_INITIAL_COST 1e-7   // ms par pixel et par itération, avant mesure
+
+/* Modèle de coût : durée = cost * pixels * itérations. Le modèle est grossier
+   (seuls les points de l'ensemble vont jusqu'au bout des itérations) mais la
+   moyenne glissante le recale à chaque mesure sur la zone affichée */
+static double budget;              // durée visée d'un rendu (ms)
+static int nbPixels;
+static double cost = BUDGET_INITIAL_COST;
+
+void budget_init(double fps, int _nbPixels)
+{
+	budget = 1000.0 / fps;
+	nbPixels = _nbPixels;
+	cost = BUDGET_INITIAL_COST;
+}
+
+void budget_next(int nbMaxIt, int *scale, int *frameIt)
+{
+	double predicted;
+	int s;
+	// plus grande résolution tenant dans le budget
+	for (s = 1; s < BUDGET_MAX_SCALE; ++s)
+		if (cost * nbPixels / (s*s) * nbMaxIt <= budget)
+			break;
+	*scale = s;
+	*frameIt = nbMaxIt;
+	// même à la résolution minimale le budget est dépassé : moins d'itérations
+	predicted = cost * nbPixels / (s*s) * nbMaxIt;
+	if (predicted > budget) {
+		*frameIt = (int) (nbMaxIt * budget / predicted);
+		if (*frameIt < NBMAXIT_MIN)
+			*frameIt = NBMAXIT_MIN;
+	}
+}
+
+void budget_report(int scale, int frameIt, double ms)
+{
+	const double measured = ms / ((double) nbPixels / (scale*scale) * frameIt);
+	cost += BUDGET_SMOOTHING * (measured - cost);
+}
@@ -0,0 +1,25 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+/* Contrôleur de budget par image pour la navigation interactive : choisit la
+   résolution interne et le nombre d'itérations des rendus en mouvement afin
+   de tenir une cadence donnée, à partir des durées de rendu mesurées */
+
+#define BUDGET_MAX_SCALE 8         // résolution interne minimale : 1/8
+
+/* Initialise le contrôleur
+   - fps : cadence visée (images par seconde) 
+   - nbPixels : nombre de pixels de l'image à pleine résolution */
+void budget_init(double fps, int nbPixels);
+
+/* Choisit les paramètres du prochain rendu en mouvement
+   - nbMaxIt : nombre d'itérations de l'image en pleine qualité
+   - scale : facteur de réduction de la résolution (1 à BUDGET_MAX_SCALE)
+   - frameIt : nombre d'itérations à utiliser (<= nbMaxIt) */
+void budget_next(int nbMaxIt, int *scale, int *frameIt);
+
+/* Signale la durée (en millisecondes) d'un rendu réalisé avec les paramètres
+   donnés, qu'il ait été choisi par budget_next ou non */
+void budget_report(int scale, int frameIt, double ms);
+
+#endif
@@ -0,0 +1,231 @@
+#include <math.h>
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "mandelbrot.h"
+#include "types.h"
+
+/* Tests de non-régression du moteur (make check) : rend un catalogue de
+   scènes fixes et compare leur canal ITERATIONS aux données de référence
+   Usage : check_mandel [-u] répertoire
+   -u : régénère les références au lieu de les comparer */
+
+#define CHECK_THREADS 4
+#define CHECK_WIDTH 128
+#define CHECK_HEIGHT 96
+#define CHECK_MAGIC "MANDELREF"
+#define COLOR_DEPTH 32
+#define MICROSEC_IN_A_SEC 1000000
+
+/* Scène : paramètres du rendu et tolérances de la comparaison
+   - reference : nom des données de référence (une scène peut être comparée
+     aux données d'une autre, rendue autrement)
+   - tolerance : écart toléré sur le nombre d'itérations lissé d'un pixel
+   - maxMismatches : fraction des pixels pouvant dépasser la tolérance (les
+     pixels chaotiques près du bord de l'ensemble, sensibles aux arrondis) */
+struct scene {
+	const char *name;
+	const char *reference;
+	struct bounds bounds;
+	struct complex init;
+	int julia;
+	int nbMaxIt;
+	int formula, power;
+	double symmetry;
+	double tolerance;
+	double maxMismatches;
+};
+
+static const struct scene scenes[] = {
+	{"mandelbrot", "mandelbrot", {-2, 2, -1.5, 1.5}, {0, 0}, 0, 256,
+		MANDELBROT_FORMULA_Z2, 2, -1, 1e-4, 0},
+	// reflets à 1e-3 ligne près : écarts limités au voisinage du bord
+	{"mandelbrot_sym", "mandelbrot", {-2, 2, -1.5, 1.5}, {0, 0}, 0, 256,
+		MANDELBROT_FORMULA_Z2, 2, MANDELBROT_SYMMETRY_DEFAULT, 1e-2, 0.01},
+	{"seahorse", "seahorse", {-0.7485, -0.7425, 0.098, 0.104}, {0, 0}, 0, 3000,
+		MANDELBROT_FORMULA_Z2, 2, -1, 1e-3, 0.001},
+	{"deep", "deep", {-0.74364388705, -0.74364388701, 0.13182590419, 0.13182590422},
+		{0, 0}, 0, 5000, MANDELBROT_FORMULA_Z2, 2, -1, 1e-2, 0.01},
+	{"julia", "julia", {-1.6, 1.6, -1.2, 1.2}, {-0.8, 0.156}, 1, 500,
+		MANDELBROT_FORMULA_Z2, 2, -1, 1e-3, 0.001},
+	{"z3", "z3", {-1.5, 1.5, -1.2, 1.2}, {0, 0}, 0, 256,
+		MANDELBROT_FORMULA_ZN, 3, -1, 1e-4, 0},
+	{"burningship", "burningship", {-1.8, -1.7, -0.09, 0.01}, {0, 0}, 0, 500,
+		MANDELBROT_FORMULA_BURNINGSHIP, 2, -1, 1e-3, 0.001},
+	{"tricorn", "tricorn", {-2, 2, -1.5, 1.5}, {0, 0}, 0, 256,
+		MANDELBROT_FORMULA_TRICORN, 2, -1, 1e-4, 0},
+	{"newton", "newton", {-2, 2, -1.5, 1.5}, {0, 0}, 1, 64,
+		MANDELBROT_FORMULA_NEWTON, 2, -1, 0, 0.001}
+};
+#define NBSCENES ((int) (sizeof(scenes) / sizeof(scenes[0])))
+
+/*********************************************/
+/*******          UTILITAIRES      ***********/
+/*********************************************/
+
+/* Rend la scène, renvoie la durée du rendu (ms) */
+static double render(const struct scene *scene, SDL_Surface *s, float *iterations)
+{
+	struct mandelbrot_job job;
+	struct timeval start, end;
+	mandelbrot_initJob(&job, scene->bounds, scene->init, scene->julia,
+			scene->nbMaxIt, s);
+	job.formula = scene->formula;
+	job.power = scene->power;
+	job.symmetry = scene->symmetry;
+	job.channels[MANDELBROT_INDEX_ITERATIONS] = iterations;
+	gettimeofday(&start, NULL);
+	mandelbrot_renderJobs(&job, 1);
+	gettimeofday(&end, NULL);
+	return (end.tv_sec - start.tv_sec) * 1000.0
+		+ (double) (end.tv_usec - start.tv_usec) * 1000 / MICROSEC_IN_A_SEC;
+}
+
+/* Les valeurs sont stockées en petit-boutiste, quelle que soit la machine */
+static void write_values(FILE *file, const float *values, int n)
+{
+	Uint32 v;
+	int i;
+	for (i = 0; i < n; ++i) {
+		memcpy(&v, &values[i], sizeof(v));
+		fputc(v & 0xff, file); fputc((v >> 8) & 0xff, file);
+		fputc((v >> 16) & 0xff, file); fputc((v >> 24) & 0xff, file);
+	}
+}
+
+static int read_values(FILE *file, float *values, int n)
+{
+	unsigned char b[4];
+	Uint32 v;
+	int i;
+	for (i = 0; i < n; ++i) {
+		if (fread(b, 1, 4, file) != 4)
+			return 0;
+		v = b[0] | (b[1] << 8) | (b[2] << 16) | ((Uint32) b[3] << 24);
+		memcpy(&values[i], &v, sizeof(v));
+	}
+	return 1;
+}
+
+/* Sauvegarde la référence : en-tête texte (dimension, itérations, durée du
+   rendu) puis les valeurs du canal ITERATIONS */
+static void save_reference(const char *fileName, const struct scene *scene,
+		const float *values, double ms)
+{
+	FILE *file = fopen(fileName, "wb");
+	if (file == NULL) {
+		printf("\nImpossible d'écrire \"%s\"\n", fileName); exit(EXIT_FAILURE);
+	}
+	fprintf(file, "%s %d %d %d %.3f\n", CHECK_MAGIC, CHECK_WIDTH, CHECK_HEIGHT,
+			scene->nbMaxIt, ms);
+	write_values(file, values, CHECK_WIDTH*CHECK_HEIGHT);
+	fclose(file);
+}
+
+/* Charge la référence, renvoie 0 si elle est absente ou incompatible */
+static int load_reference(const char *fileName, const struct scene *scene,
+		float *values, double *ms)
+{
+	char magic[16];
+	int w, h, nbMaxIt, ok;
+	FILE *file = fopen(fileName, "rb");
+	if (file == NULL)
+		return 0;
+	ok = fscanf(file, "%15s %d %d %d %lf", magic, &w, &h, &nbMaxIt, ms) == 5
+		&& fgetc(file) == '\n'
+		&& strcmp(magic, CHECK_MAGIC) == 0 && w == CHECK_WIDTH && h == CHECK_HEIGHT
+		&& nbMaxIt == scene->nbMaxIt
+		&& read_values(file, values, CHECK_WIDTH*CHECK_HEIGHT);
+	fclose(file);
+	return ok;
+}
+
+/* Compte les pixels dont l'écart dépasse la tolérance (un point de
+   l'ensemble devenu extérieur, ou l'inverse, en fait partie) */
+static int compare(const struct scene *scene, const float *values,
+		const float *expected, double *maxDiff)
+{
+	const float inside = scene->nbMaxIt;
+	double diff;
+	int i, mismatches = 0;
+	*maxDiff = 0;
+	for (i = 0; i < CHECK_WIDTH*CHECK_HEIGHT; ++i) {
+		if ((values[i] >= inside) != (expected[i] >= inside)) {
+			++mismatches;
+			continue;
+		}
+		diff = fabs(values[i] - expected[i]);
+		*maxDiff = (diff > *maxDiff) ? diff : *maxDiff;
+		if (diff > scene->tolerance)
+			++mismatches;
+	}
+	return mismatches;
+}
+
+/*********************************************/
+/*******             MAIN          ***********/
+/*********************************************/
+
+int main(int argc, char *argv[])
+{
+	char fileName[1024];
+	const int size = CHECK_WIDTH*CHECK_HEIGHT;
+	float *values = (float*) malloc(size * sizeof(float));
+	float *expected = (float*) malloc(size * sizeof(float));
+	SDL_Surface *s;
+	const char *dir;
+	double ms, refMs, maxDiff;
+	int i, update, mismatches, allowed, failures = 0;
+
+	update = (argc == 3 && strcmp(argv[1], "-u") == 0);
+	if (argc != 2 + update) {
+		printf("Usage : %s [-u] répertoire\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	dir = argv[1 + update];
+	s = SDL_CreateRGBSurface(0, CHECK_WIDTH, CHECK_HEIGHT, COLOR_DEPTH, 0, 0, 0, 0);
+	if (s == NULL) {
+		printf("Impossible d'obtenir une surface graphique\n"); return EXIT_FAILURE;
+	}
+	mandelbrot_init(CHECK_THREADS);
+	mandelbrot_setDisplay(0);
+
+	if (!update)
+		// largeurs corrigées des caractères accentués (deux octets)
+		printf("%-17s %10s %11s %12s %10s %12s\n", "scène", "écarts", "tolérés",
+				"écart max", "temps", "référence");
+	for (i = 0; i < NBSCENES; ++i) {
+		ms = render(&scenes[i], s, values);
+		sprintf(fileName, "%s/%s.ref", dir, scenes[i].reference);
+		if (update) {
+			if (strcmp(scenes[i].name, scenes[i].reference) == 0) {
+				save_reference(fileName, &scenes[i], values, ms);
+				printf("%-16s référence enregistrée (%.1f ms)\n", scenes[i].name, ms);
+			}
+			continue;
+		}
+		if (!load_reference(fileName, &scenes[i], expected, &refMs)) {
+			printf("%-16s référence \"%s\" absente ou incompatible\n",
+					scenes[i].name, fileName);
+			++failures;
+			continue;
+		}
+		mismatches = compare(&scenes[i], values, expected, &maxDiff);
+		allowed = (int) (scenes[i].maxMismatches * size);
+		printf("%-16s %9d %9d %11.2e %7.1f ms %7.1f ms%s\n", scenes[i].name,
+				mismatches, allowed, maxDiff, ms, refMs,
+				(mismatches > allowed) ? "  ECHEC" : "");
+		failures += (mismatches > allowed);
+	}
+	if (!update)
+		printf("%d scène(s) sur %d non conforme(s)\n", failures, NBSCENES);
+
+	mandelbrot_close();
+	SDL_FreeSurface(s);
+	free(values);
+	free(expected);
+	return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
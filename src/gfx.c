@@ -1,14 +1,30 @@
-﻿#include <SDL/SDL.h>
+﻿#include <math.h>
+#include <SDL/SDL.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "atlas.h"
+#include "batch.h"
+#include "buddhabrot.h"
+#include "budget.h"
 #include "gfx.h"
 #include "mandelbrot.h"
 #include "options.h"
+#include "server.h"
+#include "sweep.h"
+#include "tiles.h"
 #include "types.h"
 
 #define COLOR_DEPTH 32            // couleurs 32 bits
+#define WHEEL_ZOOM 1.25           // facteur de zoom d'un cran de molette
+#define IDLE_DELAY 150            // ms sans mouvement avant le rendu pleine qualité
+#define COST_PIXEL 2.0            // coût fixe d'un pixel (en itérations)
+#define PREVIEW_SCALE 3           // réduction de la résolution de l'aperçu
+#define PREVIEW_MAX_IT 256        // nombre d'itérations max de l'aperçu
+#define PREVIEW_PRIORITY -1       // priorité des aperçus (vue principale : 0)
+#define PREVIEW_WORKERS 4         // part des threads ouverte aux aperçus : 1/4
 
 /*********************************************/
 /*******    VARIABLES DU MODULE    ***********/
@@ -17,6 +33,12 @@
 /* Données utilisées pour le rendu */
 static SDL_Surface *surface;
 static struct dimension dim; 
+static struct mandelbrot_job job;
+static float *channels[MANDELBROT_NBCHANNELS]; // canaux supplémentaires (photo, capture)
+static const char *channel_names[MANDELBROT_NBCHANNELS] = 
+		{"distance", "trap", "stripe", "iterations"};
+static float *costs;              // coût prévu des lignes (capture, NULL sinon)
+static double *threadTimes;       // temps de calcul de chaque thread (capture)
 
 /* Paramètres du rendu */
 static struct bounds bounds;      // bornes espace
@@ -24,6 +46,37 @@ static struct complex init;       // z0 (Mandelbrot) ou c (Julia)
 static int nbMaxIt;               // nombre iterations max par point
 static int julia;                 // Julia (1) ou Mandelbrot (0) ?
 
+/* Navigation interactive : les rendus sont asynchrones, à résolution réduite
+   pendant les mouvements (voir budget), puis en pleine qualité à l'arrêt */
+static SDL_Surface *frame;                       // dernière image terminée
+static struct bounds frameBounds;                // ses bornes
+static struct complex frameInit;                 // son init
+static int frameJulia;                           // Julia ou Mandelbrot ?
+static SDL_Surface *scaled[BUDGET_MAX_SCALE+1];  // surfaces de rendu réduit
+static float *iterations[BUDGET_MAX_SCALE+1];    // et leurs canaux ITERATIONS
+static int equalize;                             // égalisation d'histogramme ?
+static struct bounds renderBounds;               // bornes du rendu en cours
+static int renderScale, renderIt;                // réduction, itérations
+static int rendering;                            // rendu en cours ?
+static int renderId;                             // numéro du rendu en cours
+static Uint32 renderStart;                       // début du rendu (ms)
+static int changed;                              // vue modifiée depuis le rendu ?
+static int sharp;                                // image affichée en pleine qualité ?
+static Uint32 lastInput;                         // dernier mouvement (ms)
+
+/* Aperçu de Julia (--preview) : un volet carré à droite de la vue montre
+   l'ensemble de Julia du point c sous le curseur, rendu à basse résolution
+   par une partie des threads et après les lignes de la vue principale */
+static int paneSize;                             // côté du volet (0 : sans)
+static struct mandelbrot_job preview;            // rendu de l'aperçu
+static SDL_Surface *previewSurface;              // dernier aperçu terminé (affiché)
+static SDL_Surface *previewTarget;               // aperçu en cours de rendu
+static struct complex previewC;                  // c sous le curseur
+static int previewing;                           // aperçu en cours de rendu ?
+static int previewId;                            // numéro de l'aperçu en cours
+static int previewChanged;                       // curseur déplacé depuis ?
+static int previewShown;                         // un aperçu est-il terminé ?
+
 /*********************************************/
 /*******        INITIALISATIONS    ***********/
 /*********************************************/
@@ -34,7 +87,8 @@ static void init_window()
 	int flags = SDL_DOUBLEBUF;
 	if (options_getFullscreen()) 
 		flags = SDL_FULLSCREEN;
-	surface = SDL_SetVideoMode(dim.width, dim.height, COLOR_DEPTH, flags);
+	paneSize = options_getPreview() ? dim.height : 0;
+	surface = SDL_SetVideoMode(dim.width + paneSize, dim.height, COLOR_DEPTH, flags);
 	if (surface == NULL) {
 		printf("\nImpossible de créer une fenêtre\n"); exit(EXIT_FAILURE);
 	}
@@ -49,29 +103,348 @@ static void init_noWindow()
 	}
 }
 
+/* Alloue les buffers des canaux supplémentaires demandés 
+   (et du canal ITERATIONS pour l'égalisation et la prévision des coûts) */
+static void init_channels()
+{
+	int i;
+	for (i = 0; i < MANDELBROT_NBCHANNELS; ++i)
+		if ((options_getChannels() & (1 << i)) || (i == MANDELBROT_INDEX_ITERATIONS 
+					&& (options_getEqualize() || options_getPredict())))
+			channels[i] = (float*) malloc(dim.width * dim.height * sizeof(float));
+}
+
 /**********************************************/
 /*******  MISE A JOUR DE LA SURFACE  **********/
 /**********************************************/
 
-/* Met à jour la surface via l'appel au moteur */
+/* Met à jour la surface (et les canaux) via l'appel au moteur */
 static void render() 
 {
-	mandelbrot_render(bounds, init, julia, nbMaxIt, surface);
-}
-
-/* Met a jour l'ecran en recalculant l'ensemble voulu */
-static void refresh() 
-{
-	render();
-	SDL_Flip(surface);
+	int i;
+	mandelbrot_initJob(&job, bounds, init, julia, nbMaxIt, surface);
+	job.formula = options_getFormula();
+	job.power = options_getPower();
+	job.symmetry = options_getSymmetry();
+	for (i = 0; i < MANDELBROT_NBCHANNELS; ++i)
+		job.channels[i] = channels[i];
+	job.costs = costs;
+	job.threadTimes = threadTimes;
+	mandelbrot_renderJobs(&job, 1);
+	if (options_getEqualize())
+		mandelbrot_colorize(&job, MANDELBROT_COLORING_EQUALIZED, surface);
 }
 
-/* Sauvegarde la surface dans un fichier nom%num.bmp */
+/* Sauvegarde la surface dans un fichier nom%num.bmp 
+   et chaque canal supplémentaire dans nom_canal%num.bmp */
 static void saveBMP(int num)
 {
 	char name[1024];
+	int i;
 	sprintf(name, "%s%i.bmp", options_getPictureName(), num);
 	SDL_SaveBMP(surface, name); 
+	for (i = 0; i < MANDELBROT_NBCHANNELS; ++i)
+		if (options_getChannels() & (1 << i)) {
+			SDL_Surface *grey = SDL_CreateRGBSurface(0, dim.width, dim.height, 
+					COLOR_DEPTH, 0, 0, 0, 0); 
+			mandelbrot_drawChannel(&job, 1 << i, grey);
+			sprintf(name, "%s_%s%i.bmp", options_getPictureName(), channel_names[i], num);
+			SDL_SaveBMP(grey, name); 
+			SDL_FreeSurface(grey);
+		}
+}
+
+/**********************************************/
+/*******   PREVISION DES COUTS (CAPTURE) ******/
+/**********************************************/
+
+/* Prévoit le coût des lignes de la vue courante à partir des itérations de
+   l'image précédente, de bornes previous : chaque pixel coûte les itérations
+   du pixel de l'image précédente qui couvrait le même point */
+static void predict_costs(struct bounds previous)
+{
+	const float *values = channels[MANDELBROT_INDEX_ITERATIONS];
+	const double xScale = (bounds.xmax - bounds.xmin) / (previous.xmax - previous.xmin);
+	const double yScale = (bounds.ymax - bounds.ymin) / (previous.ymax - previous.ymin);
+	const double xOffset = (bounds.xmin - previous.xmin) * dim.width / (previous.xmax - previous.xmin);
+	const double yOffset = (bounds.ymin - previous.ymin) * dim.height / (previous.ymax - previous.ymin);
+	int *srcX = (int*) malloc(dim.width * sizeof(int));
+	double cost;
+	int x, y, sy;
+
+	if (costs == NULL)
+		costs = (float*) malloc(dim.height * sizeof(float));
+	for (x = 0; x < dim.width; ++x) {
+		srcX[x] = (int) floor(xOffset + xScale * (x + 0.5));
+		srcX[x] = (srcX[x] < 0) ? 0 : ((srcX[x] >= dim.width) ? dim.width-1 : srcX[x]);
+	}
+	for (y = 0; y < dim.height; ++y) {
+		sy = (int) floor(yOffset + yScale * (y + 0.5));
+		sy = (sy < 0) ? 0 : ((sy >= dim.height) ? dim.height-1 : sy);
+		for (x = 0, cost = 0; x < dim.width; ++x)
+			cost += values[sy*dim.width + srcX[x]] + COST_PIXEL;
+		costs[y] = (float) cost;
+	}
+	free(srcX);
+}
+
+/* Affiche le déséquilibre entre threads prévu et réel de l'image num */
+static void report_balance(int num)
+{
+	const int n = mandelbrot_getNbThreads();
+	double total = 0, max = 0;
+	int t;
+	for (t = 0; t < n; ++t) {
+		total += threadTimes[t];
+		max = (threadTimes[t] > max) ? threadTimes[t] : max;
+	}
+	if (job.costs == NULL)
+		printf("\rImage %d : ordre naturel, déséquilibre réel %5.1f %%            \n", 
+				num, (total > 0) ? 100 * (max * n / total - 1) : 0);
+	else
+		printf("\rImage %d : déséquilibre prévu %5.1f %%, réel %5.1f %%            \n", 
+				num, 100 * job.predictedImbalance, 
+				(total > 0) ? 100 * (max * n / total - 1) : 0);
+}
+
+/**********************************************/
+/*******   NAVIGATION INTERACTIVE    **********/
+/**********************************************/
+
+/* Crée une surface hors écran au format de la fenêtre (les pixels peuvent 
+   ainsi être recopiés tels quels) */
+static SDL_Surface *create_surface(int w, int h)
+{
+	SDL_Surface *s = SDL_CreateRGBSurface(0, w, h, COLOR_DEPTH, 
+			surface->format->Rmask, surface->format->Gmask, surface->format->Bmask, 0);
+	if (s == NULL) {
+		printf("\nImpossible d'obtenir une surface graphique\n"); exit(EXIT_FAILURE);
+	}
+	return s;
+}
+
+/* Surface de rendu réduit d'un facteur scale (dimensions arrondies au-dessus) */
+static SDL_Surface *get_scaled(int scale)
+{
+	if (scaled[scale] == NULL) {
+		scaled[scale] = create_surface((dim.width + scale-1) / scale, 
+				(dim.height + scale-1) / scale);
+		iterations[scale] = (float*) malloc(scaled[scale]->w * scaled[scale]->h 
+				* sizeof(float));
+	}
+	return scaled[scale];
+}
+
+/* Appelée par le moteur à la fin d'un rendu : réveille la boucle d'événements
+   (code : numéro du rendu, opposé du numéro de l'aperçu) */
+static void render_done(struct mandelbrot_job *job, void *data)
+{
+	SDL_Event event;
+	event.type = SDL_USEREVENT;
+	event.user.code = (int) (long) data;
+	SDL_PushEvent(&event);
+}
+
+/* Lance le rendu asynchrone de la vue courante, réduit selon le budget 
+   (full : 0) ou en pleine qualité (full : 1) */
+static void start_render(int full)
+{
+	SDL_Surface *s;
+	if (full) {
+		renderScale = 1;
+		renderIt = nbMaxIt;
+	} else {
+		budget_next(nbMaxIt, &renderScale, &renderIt);
+	}
+	s = get_scaled(renderScale);
+	// un pixel réduit couvre renderScale^2 pixels de l'écran
+	renderBounds = bounds;
+	if (s->w * renderScale != dim.width)
+		renderBounds.xmax = bounds.xmin 
+			+ (bounds.xmax - bounds.xmin) * s->w * renderScale / dim.width;
+	if (s->h * renderScale != dim.height)
+		renderBounds.ymax = bounds.ymin 
+			+ (bounds.ymax - bounds.ymin) * s->h * renderScale / dim.height;
+	mandelbrot_initJob(&job, renderBounds, init, julia, renderIt, s);
+	job.formula = options_getFormula();
+	job.power = options_getPower();
+	job.symmetry = options_getSymmetry();
+	job.channels[MANDELBROT_INDEX_ITERATIONS] = iterations[renderScale];  // recoloration
+	job.callback = render_done;
+	job.data = (void*) (long) ++renderId;
+	renderBounds = bounds;
+	renderStart = SDL_GetTicks();
+	rendering = 1;
+	mandelbrot_submit(&job);
+}
+
+/* Annule le rendu en cours */
+static void cancel_render()
+{
+	if (!rendering)
+		return;
+	mandelbrot_cancel(&job);
+	mandelbrot_wait(&job);
+	rendering = 0;
+}
+
+/* Dessine le dernier aperçu terminé, agrandi, dans le volet (noir si la vue
+   montre un ensemble de Julia) */
+static void draw_pane()
+{
+	const int w = previewSurface->w, h = previewSurface->h;
+	Uint32 *src, *dst;
+	int x, y;
+	for (y = 0; y < paneSize; ++y) {
+		dst = (Uint32*) surface->pixels + y*(surface->pitch/4) + dim.width;
+		if (!previewShown || julia) {
+			memset(dst, 0, paneSize * sizeof(Uint32));
+			continue;
+		}
+		src = (Uint32*) previewSurface->pixels + (y*h/paneSize)*(previewSurface->pitch/4);
+		for (x = 0; x < paneSize; ++x)
+			dst[x] = src[x*w/paneSize];
+	}
+}
+
+/* Affiche la dernière image terminée, reprojetée sur les bornes courantes
+   (pixels hors de l'image en noir) */
+static void display()
+{
+	const double xRatio = (bounds.xmax - bounds.xmin) / (frameBounds.xmax - frameBounds.xmin);
+	const double yRatio = (bounds.ymax - bounds.ymin) / (frameBounds.ymax - frameBounds.ymin);
+	// décalage (en pixels de frame) du coin de la vue courante
+	const double xOffset = (bounds.xmin - frameBounds.xmin) * dim.width 
+		/ (frameBounds.xmax - frameBounds.xmin);
+	const double yOffset = (bounds.ymin - frameBounds.ymin) * dim.height 
+		/ (frameBounds.ymax - frameBounds.ymin);
+	int *srcX;
+	Uint32 *src, *dst;
+	int x, y, sy;
+
+	// une image d'un autre ensemble ne peut être reprojetée : l'écran est gardé
+	if (frameJulia != julia || frameInit.real != init.real || frameInit.im != init.im)
+		return;
+	srcX = (int*) malloc(dim.width * sizeof(int));
+	for (x = 0; x < dim.width; ++x)
+		srcX[x] = (int) floor(xOffset + xRatio * x);
+	for (y = 0; y < dim.height; ++y) {
+		dst = (Uint32*) surface->pixels + y*(surface->pitch/4);
+		sy = (int) floor(yOffset + yRatio * y);
+		if (sy < 0 || sy >= dim.height) {
+			memset(dst, 0, dim.width * sizeof(Uint32));
+			continue;
+		}
+		src = (Uint32*) frame->pixels + sy*(frame->pitch/4);
+		for (x = 0; x < dim.width; ++x)
+			dst[x] = (srcX[x] < 0 || srcX[x] >= dim.width) ? 0 : src[srcX[x]];
+	}
+	free(srcX);
+	if (paneSize > 0)
+		draw_pane();
+	SDL_Flip(surface);
+}
+
+/* Agrandit le dernier rendu dans frame et l'affiche */
+static void show_render()
+{
+	const SDL_Surface *s = job.surface;
+	Uint32 *src, *dst;
+	int x, y;
+	for (y = 0; y < dim.height; ++y) {
+		src = (Uint32*) s->pixels + (y/renderScale)*(s->pitch/4);
+		dst = (Uint32*) frame->pixels + y*(frame->pitch/4);
+		for (x = 0; x < dim.width; ++x)
+			dst[x] = src[x/renderScale];
+	}
+	frameBounds = renderBounds;
+	frameInit = job.init;
+	frameJulia = job.julia;
+	display();
+}
+
+/* Le rendu en cours est terminé */
+static void finish_render()
+{
+	const double ms = SDL_GetTicks() - renderStart;
+	rendering = 0;
+	budget_report(renderScale, renderIt, ms);
+	if (equalize)
+		mandelbrot_colorize(&job, MANDELBROT_COLORING_EQUALIZED, job.surface);
+	sharp = (renderScale == 1 && renderIt == nbMaxIt);
+	if (sharp) {
+		printf("\rCalcul terminé en %2.3f secondes! ", ms / 1000);
+		fflush(stdout);
+	}
+	show_render();
+}
+
+/* Recolore le dernier rendu à partir de ses itérations, ou le recalcule 
+   s'il a été annulé (Newton : la couleur dépend aussi de la racine) */
+static void recolor()
+{
+	if (rendering)
+		return;  // le rendu en cours sera coloré à sa fin
+	if (renderId == 0 || job.cancelled || job.formula == MANDELBROT_FORMULA_NEWTON) {
+		changed = 1;
+		return;
+	}
+	mandelbrot_colorize(&job, equalize ? MANDELBROT_COLORING_EQUALIZED 
+			: MANDELBROT_COLORING_LINEAR, job.surface);
+	show_render();
+}
+
+/* Point de l'espace sous le pixel (x, y) de la vue */
+static struct complex pointAt(int x, int y)
+{
+	struct complex c;
+	c.real = bounds.xmin + (bounds.xmax - bounds.xmin) * x / dim.width;
+	c.im = bounds.ymin + (bounds.ymax - bounds.ymin) * y / dim.height;
+	return c;
+}
+
+/* Lance le rendu asynchrone de l'aperçu de Julia de previewC, limité à une
+   partie des threads et de priorité inférieure à la vue principale */
+static void start_preview()
+{
+	const int nbWorkers = mandelbrot_getNbThreads() / PREVIEW_WORKERS;
+	const double e = MANDELBROT_JULIA_EXTENT;
+	struct bounds b = {-e, e, -e, e};
+	mandelbrot_initJob(&preview, b, previewC, 1, 
+			(nbMaxIt < PREVIEW_MAX_IT) ? nbMaxIt : PREVIEW_MAX_IT, previewTarget);
+	preview.formula = options_getFormula();
+	preview.power = options_getPower();
+	preview.symmetry = options_getSymmetry();
+	preview.priority = PREVIEW_PRIORITY;
+	preview.maxWorkers = (nbWorkers > 1) ? nbWorkers : 1;
+	preview.callback = render_done;
+	preview.data = (void*) (long) -(++previewId);
+	previewing = 1;
+	mandelbrot_submit(&preview);
+}
+
+/* Annule l'aperçu en cours (ses lignes en cours de calcul sont courtes) */
+static void cancel_preview()
+{
+	if (!previewing)
+		return;
+	mandelbrot_cancel(&preview);
+	mandelbrot_wait(&preview);
+	previewing = 0;
+}
+
+/* L'aperçu en cours est terminé : il est affiché dans le volet
+   Les threads n'écrivant plus dans sa surface, elle est échangée avec celle
+   de l'aperçu affiché, qui recevra le prochain rendu */
+static void finish_preview()
+{
+	SDL_Surface *tmp = previewSurface;
+	previewSurface = previewTarget;
+	previewTarget = tmp;
+	previewing = 0;
+	previewShown = 1;
+	draw_pane();
+	SDL_Flip(surface);
 }
 
 /**********************************************/
@@ -135,6 +508,29 @@ static void unzoomView(double factor)
 	bounds.ymax += deplY; 
 }
 
+/* Zoom (factor > 1) / Dezoom (factor < 1) en gardant fixe le point 
+   sous le pixel (x, y) */
+static void zoomAt(int x, int y, double factor)
+{
+	const double px = bounds.xmin + (bounds.xmax - bounds.xmin) * x / dim.width;
+	const double py = bounds.ymin + (bounds.ymax - bounds.ymin) * y / dim.height;
+	bounds.xmin = px - (px - bounds.xmin) / factor;
+	bounds.xmax = px + (bounds.xmax - px) / factor;
+	bounds.ymin = py - (py - bounds.ymin) / factor;
+	bounds.ymax = py + (bounds.ymax - py) / factor;
+}
+
+/* Deplace la vue pour suivre un glissement de (dx, dy) pixels */
+static void dragView(int dx, int dy)
+{
+	const double deplX = (bounds.xmax - bounds.xmin) * dx / dim.width;
+	const double deplY = (bounds.ymax - bounds.ymin) * dy / dim.height;
+	bounds.xmin -= deplX;
+	bounds.xmax -= deplX;
+	bounds.ymin -= deplY;
+	bounds.ymax -= deplY;
+}
+
 /* Modifie le nombre d'iterations d'un facteur donné */
 static void incrIt(double factor) 
 {
@@ -164,6 +560,12 @@ static void afficheParams()
 	printf(" -i %2.2f %2.2f", init.real, init.im);
 	printf(" -n %d", nbMaxIt);
 	if (julia) printf(" -j");
+	if (options_getFormula() != FORMULA_DEFAULT) {
+		const char *names[MANDELBROT_NBFORMULAS] = MANDELBROT_FORMULA_NAMES;
+		printf(" --formula %s", names[options_getFormula()]);
+		if (options_getFormula() == MANDELBROT_FORMULA_ZN)
+			printf(" %d", options_getPower());
+	}
 	printf("\n");
 }
 
@@ -174,7 +576,17 @@ static void treatKeyDown(SDL_Event *event)
 		case SDLK_r:
 			resetView(); break;
 		case SDLK_f:
-			mandelbrot_changeColors(); break;
+			// la table des couleurs ne doit pas être en cours d'utilisation
+			cancel_render();
+			cancel_preview();
+			mandelbrot_changeColors();
+			recolor();
+			previewChanged = (paneSize > 0);
+			return;
+		case SDLK_e:
+			equalize = !equalize;
+			recolor();
+			return;
 		case SDLK_UP:
 			upView(); break; 
 		case SDLK_DOWN:
@@ -207,7 +619,60 @@ static void treatKeyDown(SDL_Event *event)
 		default:
 			return; 
 	}
-	refresh(); 
+	changed = 1;
+}
+
+/* Traite un événement, renvoie 0 pour quitter */
+static int treatEvent(SDL_Event *event)
+{
+	switch (event->type) {
+		case SDL_QUIT:
+			return 0;
+		case SDL_KEYDOWN:
+			if (event->key.keysym.sym == SDLK_ESCAPE) 
+				return 0;
+			treatKeyDown(event);
+			break;
+		case SDL_MOUSEBUTTONDOWN:
+			if (event->button.x >= dim.width)
+				break;  // volet de l'aperçu
+			if (event->button.button == SDL_BUTTON_WHEELUP) {
+				zoomAt(event->button.x, event->button.y, WHEEL_ZOOM);
+				changed = 1;
+			} else if (event->button.button == SDL_BUTTON_WHEELDOWN) {
+				zoomAt(event->button.x, event->button.y, 1/WHEEL_ZOOM);
+				changed = 1;
+			} else if (event->button.button == SDL_BUTTON_RIGHT && paneSize > 0 && !julia) {
+				// ouvre l'ensemble de Julia de l'aperçu
+				init = pointAt(event->button.x, event->button.y);
+				julia = 1;
+				bounds.ymin = -MANDELBROT_JULIA_EXTENT;
+				bounds.ymax = MANDELBROT_JULIA_EXTENT;
+				bounds.xmax = MANDELBROT_JULIA_EXTENT * dim.width / dim.height;
+				bounds.xmin = -bounds.xmax;
+				changed = 1;
+			}
+			break;
+		case SDL_MOUSEMOTION:
+			if (event->motion.state & SDL_BUTTON_LMASK) {
+				dragView(event->motion.xrel, event->motion.yrel);
+				changed = 1;
+			} else if (paneSize > 0 && event->motion.x < dim.width) {
+				previewC = pointAt(event->motion.x, event->motion.y);
+				previewChanged = 1;
+			}
+			break;
+		case SDL_USEREVENT:
+			// fin d'un rendu ou d'un aperçu (ignorée s'il a été annulé depuis)
+			if (rendering && event->user.code == renderId)
+				finish_render();
+			else if (previewing && event->user.code == -previewId)
+				finish_preview();
+			break;
+		default:
+			break;
+	}
+	return 1;
 }
 
 /* Boucle de traitement des evenements */
@@ -218,7 +683,14 @@ static void gfxMainLoop()
 	printf("Haut, Bas, Gauche, Droite : déplacer la vue\n");
 	printf("r   : reinitialiser la vue\n");
 	printf("f   : changer couleurs courantes de la fractale\n");
+	printf("e   : activer/désactiver l'égalisation d'histogramme des couleurs\n");
 	printf("t/g : zoomer/dezoomer\n");
+	printf("Molette : zoomer/dezoomer autour du curseur\n");
+	printf("Clic gauche + glisser : déplacer la vue\n");
+	if (paneSize > 0) {
+		printf("Curseur : aperçu de l'ensemble de Julia du point survolé\n");
+		printf("Clic droit : afficher l'ensemble de Julia de l'aperçu\n");
+	}
 	printf("y/h : augmenter/réduire(*/1.5) le nombre d'itérations par point\n");
 	printf("u/j : augmenter/diminuer (+-0.02) la partie réelle de init (c ou z0)\n");
 	printf("i/k : augmenter/diminuer (+-0.02) la partie imaginaire de init (c ou z0)\n");
@@ -235,28 +707,72 @@ static void gfxMainLoop()
 	printf("Utilisation de %d threads\n", options_getNbThreads());
 	printf("\n");
 
-	refresh();
-
 	SDL_Event event;
+	int i, quit = 0;
 	SDL_EnableKeyRepeat(100, 50);
-	while (1) {
-		SDL_WaitEvent(&event);
-		switch (event.type) {
-			case SDL_QUIT:
-				return;
-			case SDL_KEYDOWN:
-				if(event.key.keysym.sym == SDLK_ESCAPE) 
-					return;
-				treatKeyDown(&event);
-				break;
-			default:
-				break;
+	mandelbrot_setDisplay(0);
+	budget_init(options_getFps(), dim.width * dim.height);
+	equalize = options_getEqualize();
+	frame = create_surface(dim.width, dim.height);
+	if (paneSize > 0) {
+		previewSurface = create_surface(paneSize / PREVIEW_SCALE, paneSize / PREVIEW_SCALE);
+		previewTarget = create_surface(paneSize / PREVIEW_SCALE, paneSize / PREVIEW_SCALE);
+	}
+	frameBounds = bounds;
+	frameInit = init;
+	frameJulia = julia;
+	changed = 1;
+	while (!quit) {
+		if (previewChanged && !julia) {
+			// curseur déplacé : l'aperçu précédent est abandonné
+			cancel_preview();
+			start_preview();
+			previewChanged = 0;
+		}
+		if (changed) {
+			// vue modifiée : la dernière image est reprojetée immédiatement.
+			// Un rendu réduit en cours est mené à terme (puis relancé sur la 
+			// vue courante) pour qu'une image nouvelle arrive à chaque budget
+			lastInput = SDL_GetTicks();
+			sharp = 0;
+			if (rendering && renderScale == 1 && renderIt == nbMaxIt)
+				cancel_render();
+			display();
+			if (!rendering) {
+				start_render(0);
+				changed = 0;
+			}
 		}
+		if (!rendering && !sharp) {
+			// immobile : rendu pleine qualité une fois le délai écoulé
+			if (SDL_GetTicks() - lastInput >= IDLE_DELAY)
+				start_render(1);
+			else
+				SDL_Delay(IDLE_DELAY / 10);
+		}
+		// attente de la fin du rendu ou d'une action de l'utilisateur
+		if (rendering || sharp) {
+			SDL_WaitEvent(&event);
+			quit = !treatEvent(&event);
+		}
+		while (!quit && SDL_PollEvent(&event))
+			quit = !treatEvent(&event);
+	}
+	cancel_render();
+	cancel_preview();
+	mandelbrot_setDisplay(1);
+	SDL_FreeSurface(frame);
+	SDL_FreeSurface(previewSurface);
+	SDL_FreeSurface(previewTarget);
+	for (i = 0; i <= BUDGET_MAX_SCALE; ++i) {
+		SDL_FreeSurface(scaled[i]);
+		free(iterations[i]);
 	}
 }
 
 void gfx_start() 
 {
+	int i;
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_NOPARACHUTE) < 0) {
 		printf("\nSDL Initialization failed\n"); exit(EXIT_FAILURE);
 	}
@@ -267,27 +783,58 @@ void gfx_start()
 	resetView();
 	if (options_getPhotoMode()) {
 		init_noWindow();
+		init_channels();
 		render();
 		saveBMP(0);
+	} else if (options_getServerAddress() != NULL) {
+		server_run(options_getServerAddress());
+	} else if (options_getBatchFile() != NULL) {
+		batch_run(options_getBatchFile());
+	} else if (options_getBuddhabrot()) {
+		buddhabrot_run(bounds, init, nbMaxIt, dim, 
+				options_getBuddhabrot() * 1000000LL, options_getPictureName());
+	} else if (options_getSweepPath() != NULL) {
+		sweep_run(options_getSweepPath(), options_getSweepNbFrames(), bounds, 
+				nbMaxIt, dim, options_getPictureName());
+	} else if (options_getAtlasColumns()) {
+		atlas_run(bounds, options_getAtlasColumns(), options_getAtlasRows(), 
+				options_getAtlasSize(), nbMaxIt, options_getEqualize(), 
+				options_getPictureName());
+	} else if (options_getTilesMode()) {
+		tiles_generate(bounds, init, julia, nbMaxIt, options_getFormula(),
+				options_getPower(), options_getSymmetry(), options_getTilesMaxZoom(),
+				options_getPictureName());
 	} else if (options_getCaptureMode()) {
 		init_noWindow();
+		init_channels();
 		mandelbrot_setDisplay(0);
-		int i;
+		if (options_getPredict())
+			threadTimes = (double*) malloc(options_getNbThreads() * sizeof(double));
 		double avancee;
+		struct bounds previous;
 		for (i = 0; i < options_getCaptureNbFrames(); ++i) {
 			avancee = (double) (i*100)/options_getCaptureNbFrames();
 			printf("\rGénération des images en cours... %2.1f %%    ", avancee);
 			fflush(stdout); 
 			render();
 			saveBMP(i);
+			previous = bounds;
 			zoomView(options_getCaptureZoomSpeed());
+			if (options_getPredict()) {
+				report_balance(i);
+				predict_costs(previous);
+			}
 		}
+		free(costs);
+		free(threadTimes);
 	} else {
 		init_window();
 		gfxMainLoop();
 	}
 
 	mandelbrot_close();
+	for (i = 0; i < MANDELBROT_NBCHANNELS; ++i)
+		free(channels[i]);
 	SDL_FreeSurface(surface);
 	SDL_Quit();
 	printf("\n");
@@ -1,9 +1,9 @@
 ﻿#include <math.h>
 #include <pthread.h>
 #include <SDL/SDL.h>
-#include <semaphore.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -13,8 +13,20 @@
 #define MICROSEC_IN_A_SEC 1000000
 #define LOG_2 0.693147181 
 #define NBCOLOR 4096
+#define STRIPE_DENSITY 5.0
+#define NEWTON_EPSILON 1e-12         // pas minimal de la méthode de Newton (au carré)
+#define DISTANCE_WHITE 64.0          // distance (en pixels) affichée en blanc
 #define GET_RANDOM_DOUBLE_BETWEEN(inf, sup) ((((double)rand()/(RAND_MAX))*(sup-inf))+inf)
 
+#define COLORING_MAX_BINS 65536      // nombre max de cases de l'histogramme
+
+// Force l'instanciation de calc_generic pour chaque combinaison de paramètres
+#ifdef __GNUC__
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
 // Compilation conditionnelle car windows ne connait pas sleep...
 #ifdef WIN32
 #include <windows.h>
@@ -29,26 +41,25 @@
 
 /* Synchronisation */
 static pthread_mutex_t mutex;
-static sem_t working;              // permet de controler les threads
-static sem_t waiting;              // permet d'attendre la fin du calcul
-static int finished_jobs;          // nombre de threads ayant fini le calcul
+static pthread_cond_t working;     // réveille les threads quand la file se remplit
+static pthread_cond_t waiting;     // permet d'attendre la fin du calcul
+static int unfinished_jobs;        // nombre de jobs soumis pas encore terminés
 static int nbThreads; 
 static pthread_t *threads_id;     
 static pthread_t watcher;          // surveille la progression du calcul
-static int nextLine;               // prochaine ligne à calculer 
+static struct mandelbrot_job *queue; // jobs ayant encore des lignes à distribuer
+static int totalLines;             // nombre de lignes du calcul en cours
+static int distributedLines;       // nombre de lignes distribuées
+static int stop;                   // demande d'arrêt des threads
 
 /*********************************************/
 /***            PARAMETRES DU MOTEUR      ****/
 /*********************************************/
 
-static struct bounds bounds;       // bornes de l'espace
-static struct complex init;        // c (Julia) ou z0 (Mandelbrot)
-static int nbMaxIt;                // Nombre max d'itérations par point
-static int julia;                  // Julia (1) ou Mandelbrot (0) ?
-static SDL_Surface *surface;       // surface dans laquelle rendre l'ensemble
-static double xIncr, yIncr;        // Distance entre deux points de l'espace
 static int display = 1;            // Affichage avancement et temps calcul ?
 static Uint32 color_table[NBCOLOR];// table des couleurs
+static SDL_PixelFormat color_format; // format des pixels de la table
+static int color_init = 0;         // table des couleurs initialisée ?
 
 /*********************************************/
 /***             COULEURS                 ****/
@@ -88,52 +99,530 @@ static void init_color_table(double h, double hAngleDegree, double s, double v)
                 if (h > 360)
                         h = 0;
 		HSV_to_RGB(h, s, v, &r, &g, &b);
-		color_table[i] = SDL_MapRGB(surface->format, (Uint8)r, (Uint8)g, (Uint8)b);
+		color_table[i] = SDL_MapRGB(&color_format, (Uint8)r, (Uint8)g, (Uint8)b);
 	}
 }
 
+/* (Re)construit la table si le format de la surface diffère de celui de la table
+   Toutes les surfaces de même format partagent ainsi la même table */
+static void check_color_table(SDL_PixelFormat *format)
+{
+	if (color_init && format->BitsPerPixel == color_format.BitsPerPixel
+			&& format->Rmask == color_format.Rmask 
+			&& format->Gmask == color_format.Gmask
+			&& format->Bmask == color_format.Bmask)
+		return;
+	color_format = *format;
+	color_init = 1;
+	init_color_table(0, 360, 0.9, 0.9);
+}
+
 /*********************************************/
 /***                 CALCUL               ****/
 /*********************************************/
 
-/* Calcule l'itération pour la ligne y */
-static void calc(int y) 
+/* Calcule l'itération pour la ligne y du job 
+   Fonction générique, instanciée plus bas pour chaque combinaison de formule,
+   d'ensemble (julia) et de canaux : ces paramètres étant des constantes, le 
+   compilateur élimine les branches mortes et la boucle interne ne contient 
+   ni test de formule ni appel indirect */
+static ALWAYS_INLINE void calc_generic(const struct mandelbrot_job *job, int y,
+		const int formula, const int julia, const int channels) 
 {
-	int x, it;
-	double square_module, newReal, newIm, val;
-	struct complex z, c;
-	struct complex point = {bounds.xmin, bounds.ymin + y*yIncr};
-	Uint32 *pixel = (Uint32*) surface->pixels + y*(surface->pitch/4);
-	for (x = 0; x < surface->w; ++x) {
+	int x, it, count, k;
+	double square_module, newReal, newIm, val, frac, smooth;
+	double dzReal = 0, dzIm = 0, newDzReal;       // dérivée dz/dc (ou dz/dz0)
+	double trap = 0, d;                           // piège orbital
+	double stripe = 0, lastStripe = 0;            // moyenne des stripes
+	struct complex z, c, w, p, dw;
+	const struct complex init = job->init;
+	const struct complex trapPoint = job->trap;
+	const int nbMaxIt = job->nbMaxIt;
+	const int power = job->power;
+	const double logPower = (formula == MANDELBROT_FORMULA_ZN) ? log(power) : LOG_2;
+	const double xIncr = job->xIncr;
+	const int offset = y*job->surface->w;
+	// dz/dc pour Mandelbrot (dz0 = 0, +1 par itération), dz/dz0 pour Julia
+	const double dz0 = julia ? 1 : 0;
+	// le canal distance n'a pas de sens pour Newton (pas d'échappement)
+	const int distance = (channels & MANDELBROT_CHANNEL_DISTANCE)
+		&& formula != MANDELBROT_FORMULA_NEWTON;
+	struct complex point = {job->bounds.xmin, job->bounds.ymin + y*job->yIncr};
+	Uint32 *pixel = (Uint32*) job->surface->pixels + y*(job->surface->pitch/4);
+	for (x = 0; x < job->surface->w; ++x) {
 		if (julia) {
 			// Initialisation Julia 
 			c = init; z = point;
 		} else {
 			// Initialisation Mandelbrot
 			z = init; c = point;
+			if (formula == MANDELBROT_FORMULA_NEWTON) // point critique de z - (z^3-1)/3z^2
+				z.real += 1;
+		}
+		if (distance) {
+			dzReal = dz0; dzIm = 0;
 		}
+		if (channels & MANDELBROT_CHANNEL_TRAP)
+			trap = HUGE_VAL;
+		if (channels & MANDELBROT_CHANNEL_STRIPE)
+			stripe = lastStripe = 0;
 
 		it = 0;
 		do {
-			newReal = z.real*z.real - z.im*z.im + c.real;
-			newIm = 2*z.real*z.im + c.im;
-			z.real = newReal;
-			z.im = newIm;
-			square_module = z.real*z.real + z.im*z.im;
-		} while (square_module <= 4 && ++it < nbMaxIt); 
+			// w : z replié (Burning Ship) ou conjugué (Tricorn), dw : idem pour dz
+			w = z; dw.real = dzReal; dw.im = dzIm;
+			if (formula == MANDELBROT_FORMULA_BURNINGSHIP) {
+				if (w.real < 0) { w.real = -w.real; dw.real = -dw.real; }
+				if (w.im < 0) { w.im = -w.im; dw.im = -dw.im; }
+			} else if (formula == MANDELBROT_FORMULA_TRICORN) {
+				w.im = -w.im; dw.im = -dw.im;
+			}
+
+			if (formula == MANDELBROT_FORMULA_ZN) {
+				// p = z^(n-1)
+				p = z;
+				for (k = 2; k < power; ++k) {
+					newReal = p.real*z.real - p.im*z.im;
+					p.im = p.real*z.im + p.im*z.real;
+					p.real = newReal;
+				}
+				if (distance) {
+					newDzReal = power*(p.real*dzReal - p.im*dzIm) + 1 - dz0;
+					dzIm = power*(p.real*dzIm + p.im*dzReal);
+					dzReal = newDzReal;
+				}
+				newReal = p.real*z.real - p.im*z.im + c.real;
+				newIm = p.real*z.im + p.im*z.real + c.im;
+			} else if (formula == MANDELBROT_FORMULA_NEWTON) {
+				// z - (z^3-1)/(3z^2) + c = (2z^3 + 1)/(3z^2) + c
+				p.real = z.real*z.real - z.im*z.im;
+				p.im = 2*z.real*z.im;
+				d = 3*(p.real*p.real + p.im*p.im);
+				if (d == 0)
+					d = HUGE_VAL;   // dérivée nulle : le point ne converge pas
+				newReal = 2*(p.real*z.real - p.im*z.im) + 1;
+				newIm = 2*(p.real*z.im + p.im*z.real);
+				w.real = (newReal*p.real + newIm*p.im)/d + c.real;
+				w.im = (newIm*p.real - newReal*p.im)/d + c.im;
+				newReal = w.real;
+				newIm = w.im;
+			} else {
+				if (distance) {
+					newDzReal = 2*(w.real*dw.real - w.im*dw.im) + 1 - dz0;
+					dzIm = 2*(w.real*dw.im + w.im*dw.real);
+					dzReal = newDzReal;
+				}
+				newReal = w.real*w.real - w.im*w.im + c.real;
+				newIm = 2*w.real*w.im + c.im;
+			}
+			if (formula == MANDELBROT_FORMULA_NEWTON) {
+				// pas de la méthode de Newton : fin quand il devient négligeable
+				square_module = (newReal - z.real)*(newReal - z.real)
+					+ (newIm - z.im)*(newIm - z.im);
+				z.real = newReal;
+				z.im = newIm;
+			} else {
+				z.real = newReal;
+				z.im = newIm;
+				square_module = z.real*z.real + z.im*z.im;
+			}
+			if (channels & MANDELBROT_CHANNEL_TRAP) {
+				d = (z.real - trapPoint.real)*(z.real - trapPoint.real)
+					+ (z.im - trapPoint.im)*(z.im - trapPoint.im);
+				trap = (d < trap) ? d : trap;
+			}
+			if (channels & MANDELBROT_CHANNEL_STRIPE) {
+				lastStripe = 0.5 + 0.5*sin(STRIPE_DENSITY*atan2(z.im, z.real));
+				stripe += lastStripe;
+			}
+		} while ((formula == MANDELBROT_FORMULA_NEWTON ? square_module > NEWTON_EPSILON 
+					: square_module <= 4) && ++it < nbMaxIt); 
 		point.real += xIncr;
 		if (it == nbMaxIt) {
 			*pixel = 0;
+			frac = 0;
+			count = nbMaxIt;
+			smooth = nbMaxIt;
+		} else if (formula == MANDELBROT_FORMULA_NEWTON) {
+			// un tiers de la palette par racine de z^3-1, nuancé par les itérations
+			k = (int) floor((atan2(z.im, z.real) + M_PI/3) / (2*M_PI/3)) + 3;
+			val = ((k % 3) + (double) it/nbMaxIt) / 3;
+			*pixel = color_table[(int) (val*NBCOLOR) % NBCOLOR];
+			frac = 0;
+			count = it+1;
+			smooth = it;
 		} else {
-			val = (it - (log(0.5*log(square_module))/LOG_2))/nbMaxIt;
+			smooth = it - (log(0.5*log(square_module))/logPower);
+			val = smooth/nbMaxIt;
 			val = (val<0.0)?0.0:val;
 			val = (val>1.0)?1.0:val;
 			*pixel = color_table[(int) (val*NBCOLOR) % NBCOLOR];
+			frac = 1 - log(0.5*log(square_module)/LOG_2)/logPower;
+			count = it+1;
 		}
 		++pixel;
+
+		// Canaux supplémentaires
+		if (channels & MANDELBROT_CHANNEL_DISTANCE) {
+			d = square_module*(dzReal*dzReal + dzIm*dzIm);
+			job->channels[MANDELBROT_INDEX_DISTANCE][offset+x] = (!distance || it == nbMaxIt || d == 0) ? 0 
+				: (float) (0.5*square_module*log(square_module)/sqrt(d));
+		}
+		if (channels & MANDELBROT_CHANNEL_TRAP)
+			job->channels[MANDELBROT_INDEX_TRAP][offset+x] = (float) sqrt(trap);
+		if (channels & MANDELBROT_CHANNEL_STRIPE) {
+			// interpolation entre les moyennes avec et sans la dernière itération
+			val = stripe/count;
+			if (count > 1)
+				val = (stripe - lastStripe)/(count-1) 
+					+ frac*(val - (stripe - lastStripe)/(count-1));
+			job->channels[MANDELBROT_INDEX_STRIPE][offset+x] = (float) val;
+		}
+		if (channels & MANDELBROT_CHANNEL_ITERATIONS)
+			job->channels[MANDELBROT_INDEX_ITERATIONS][offset+x] = (float) ((smooth<0.0)?0.0:smooth);
 	}
 }
 
+/* Instanciations de calc_generic (formule, julia, masque de canaux)
+   Les formules sont numérotées de 0 à MANDELBROT_NBFORMULAS-1 (mandelbrot.h) */
+#define CALC(f, j, ch) \
+	static void calc_##f##_##j##_##ch(const struct mandelbrot_job *job, int y) \
+	{ calc_generic(job, y, f, j, ch); }
+#define CALC_CHANNELS(f, j) \
+	CALC(f, j, 0) CALC(f, j, 1) CALC(f, j, 2) CALC(f, j, 3) \
+	CALC(f, j, 4) CALC(f, j, 5) CALC(f, j, 6) CALC(f, j, 7) \
+	CALC(f, j, 8) CALC(f, j, 9) CALC(f, j, 10) CALC(f, j, 11) \
+	CALC(f, j, 12) CALC(f, j, 13) CALC(f, j, 14) CALC(f, j, 15)
+#define CALC_FORMULA(f) CALC_CHANNELS(f, 0) CALC_CHANNELS(f, 1)
+CALC_FORMULA(0) CALC_FORMULA(1) CALC_FORMULA(2) CALC_FORMULA(3) CALC_FORMULA(4)
+
+#define CALC_REF_CHANNELS(f, j) { calc_##f##_##j##_0, calc_##f##_##j##_1, \
+	calc_##f##_##j##_2, calc_##f##_##j##_3, calc_##f##_##j##_4, \
+	calc_##f##_##j##_5, calc_##f##_##j##_6, calc_##f##_##j##_7, \
+	calc_##f##_##j##_8, calc_##f##_##j##_9, calc_##f##_##j##_10, \
+	calc_##f##_##j##_11, calc_##f##_##j##_12, calc_##f##_##j##_13, \
+	calc_##f##_##j##_14, calc_##f##_##j##_15 }
+#define CALC_REF_FORMULA(f) { CALC_REF_CHANNELS(f, 0), CALC_REF_CHANNELS(f, 1) }
+static void (*const calc_table[MANDELBROT_NBFORMULAS][2][1 << MANDELBROT_NBCHANNELS])
+		(const struct mandelbrot_job*, int) = {
+	CALC_REF_FORMULA(0), CALC_REF_FORMULA(1), CALC_REF_FORMULA(2),
+	CALC_REF_FORMULA(3), CALC_REF_FORMULA(4)
+};
+
+/* Calcule la ligne y du job avec l'instance correspondant à ses paramètres */
+static void calc(const struct mandelbrot_job *job, int y)
+{
+	calc_table[job->formula][job->julia != 0][job->channelMask](job, y);
+}
+
+/*********************************************/
+/***             SYMETRIE                 ****/
+/*********************************************/
+
+/* Vrai si l'image du job est symétrique par rapport à l'axe réel :
+   formule à coefficients réels, init réel et piège sur l'axe. Newton est
+   exclu car la couleur de ses racines conjuguées diffère */
+static int is_symmetric(const struct mandelbrot_job *job)
+{
+	return (job->formula == MANDELBROT_FORMULA_Z2 || job->formula == MANDELBROT_FORMULA_ZN
+			|| job->formula == MANDELBROT_FORMULA_TRICORN)
+		&& job->init.im == 0
+		&& (job->channels[MANDELBROT_INDEX_TRAP] == NULL || job->trap.im == 0)
+		&& job->symmetry >= 0
+		&& job->bounds.ymin < 0 && job->bounds.ymax > 0;
+}
+
+/* Prépare la liste des lignes à calculer d'un job symétrique :
+   les lignes de la plus grande moitié de l'image sont calculées puis recopiées
+   sur leur reflet, les lignes sans reflet sont calculées normalement.
+   Sans symétrie exploitable (reflets hors du réseau des lignes au delà de la 
+   tolérance), toutes les lignes sont calculées dans l'ordre (lines = NULL) */
+static void plan_symmetry(struct mandelbrot_job *job)
+{
+	const int h = job->surface->h;
+	// ligne (fractionnaire) de l'axe réel, reflet de y : 2*axis - y
+	const double axis = -job->bounds.ymin / job->yIncr;
+	const int twiceAxis = (int) floor(2*axis + 0.5);
+	int y, m, upper, *covered;
+
+	job->lines = job->mirrors = NULL;
+	job->nbLines = h;
+	if (!is_symmetric(job) || fabs(2*axis - twiceAxis) > job->symmetry)
+		return;
+
+	// la plus grande moitié : lignes au dessus (upper) ou en dessous de l'axe
+	upper = (h - axis) >= axis;
+	covered = (int*) calloc(h, sizeof(int));
+	job->lines = (int*) malloc(h * sizeof(int));
+	job->mirrors = (int*) malloc(h * sizeof(int));
+	for (y = 0; y < h; ++y) {
+		m = twiceAxis - y;
+		if ((upper ? y >= axis : y <= axis) && m >= 0 && m < h && m != y)
+			covered[m] = 1;
+	}
+	job->nbLines = 0;
+	for (y = 0; y < h; ++y) {
+		if (covered[y])
+			continue;
+		m = twiceAxis - y;
+		job->lines[job->nbLines] = y;
+		job->mirrors[job->nbLines] = (m >= 0 && m < h && covered[m]) ? m : -1;
+		++job->nbLines;
+	}
+	free(covered);
+}
+
+/* Recopie la ligne src calculée sur son reflet dst */
+static void mirror(const struct mandelbrot_job *job, int src, int dst)
+{
+	const int w = job->surface->w;
+	const int pitch = job->surface->pitch/4;
+	float *in, *out;
+	int i, x;
+	memcpy((Uint32*) job->surface->pixels + dst*pitch,
+			(Uint32*) job->surface->pixels + src*pitch, w*sizeof(Uint32));
+	for (i = 0; i < MANDELBROT_NBCHANNELS; ++i) {
+		if (job->channels[i] == NULL)
+			continue;
+		in = job->channels[i] + src*w;
+		out = job->channels[i] + dst*w;
+		if (i == MANDELBROT_INDEX_STRIPE) // sin(k*arg(conj z)) = -sin(k*arg(z))
+			for (x = 0; x < w; ++x)
+				out[x] = 1 - in[x];
+		else
+			memcpy(out, in, w*sizeof(float));
+	}
+}
+
+/*********************************************/
+/***           ORDONNANCEMENT             ****/
+/*********************************************/
+
+struct line_cost {
+	float cost;
+	int line, mirror;
+};
+
+/* Ordre décroissant des coûts (puis croissant des lignes) */
+static int compare_costs(const void *a, const void *b)
+{
+	const struct line_cost *la = (const struct line_cost*) a;
+	const struct line_cost *lb = (const struct line_cost*) b;
+	if (la->cost != lb->cost)
+		return (la->cost < lb->cost) ? 1 : -1;
+	return la->line - lb->line;
+}
+
+/* Ordonne les lignes à calculer du job selon leur coût prévu (les plus 
+   longues d'abord, les plus courtes comblent la fin du calcul) et prévoit
+   le déséquilibre entre threads en simulant leur distribution : chaque 
+   ligne va au thread qui se libère le premier. Les reflets suivent leur 
+   ligne et ne coûtent rien */
+static void plan_costs(struct mandelbrot_job *job)
+{
+	struct line_cost *order = (struct line_cost*) malloc(job->nbLines * sizeof(struct line_cost));
+	double *loads = (double*) calloc(nbThreads, sizeof(double));
+	double total = 0, max = 0;
+	int i, t, first;
+
+	for (i = 0; i < job->nbLines; ++i) {
+		order[i].line = (job->lines == NULL) ? i : job->lines[i];
+		order[i].mirror = (job->mirrors == NULL) ? -1 : job->mirrors[i];
+		order[i].cost = job->costs[order[i].line];
+	}
+	qsort(order, job->nbLines, sizeof(struct line_cost), compare_costs);
+	if (job->lines == NULL) {
+		job->lines = (int*) malloc(job->nbLines * sizeof(int));
+		job->mirrors = (int*) malloc(job->nbLines * sizeof(int));
+	}
+	for (i = 0; i < job->nbLines; ++i) {
+		job->lines[i] = order[i].line;
+		job->mirrors[i] = order[i].mirror;
+		for (t = 1, first = 0; t < nbThreads; ++t)
+			first = (loads[t] < loads[first]) ? t : first;
+		loads[first] += order[i].cost;
+		total += order[i].cost;
+	}
+	for (t = 0; t < nbThreads; ++t)
+		max = (loads[t] > max) ? loads[t] : max;
+	job->predictedImbalance = (total > 0) ? max * nbThreads / total - 1 : 0;
+	free(order);
+	free(loads);
+}
+
+/*********************************************/
+/***             COLORATION               ****/
+/*********************************************/
+
+/* Recoloration d'un job à partir de son canal ITERATIONS. L'égalisation 
+   se fait en trois temps, chacun réparti sur les threads du moteur :
+   - histogramme partiel des lignes de chaque tâche (pas d'écriture partagée)
+   - somme préfixe des cases : chaque tâche fusionne les histogrammes sur sa 
+     tranche de cases et en calcule la somme préfixe locale, puis ajoute la
+     somme des tranches précédentes
+   - association d'une couleur à chaque pixel */
+struct coloring {
+	const struct mandelbrot_job *job;
+	SDL_Surface *dst;
+	int mode;
+	int nbTasks;
+	int nbBins;                     // cases de l'histogramme
+	double binScale;                // cases par itération
+	Uint32 **partials;              // histogrammes partiels, un par tâche
+	double *levels;                 // fraction des pixels sous chaque case
+	double *sums;                   // nombre de pixels de chaque tranche de cases
+	Uint32 palette[NBCOLOR+1];      // table des couleurs, puis noir (ensemble)
+};
+
+/* Histogramme partiel des lignes de la tâche (points de l'ensemble exclus) */
+static void histogram_task(int task, void *data)
+{
+	struct coloring *c = (struct coloring*) data;
+	const int w = c->job->surface->w, h = c->job->surface->h;
+	const float *values = c->job->channels[MANDELBROT_INDEX_ITERATIONS] + (h*task/c->nbTasks)*w;
+	const float *end = c->job->channels[MANDELBROT_INDEX_ITERATIONS] + (h*(task+1)/c->nbTasks)*w;
+	const float nbMaxIt = c->job->nbMaxIt;
+	Uint32 *bins = c->partials[task];
+	int b;
+	memset(bins, 0, c->nbBins * sizeof(Uint32));
+	for (; values < end; ++values)
+		if (*values < nbMaxIt) {
+			b = (int) (*values * c->binScale);
+			++bins[(b < c->nbBins) ? b : c->nbBins-1];
+		}
+}
+
+/* Fusionne les histogrammes sur la tranche de cases de la tâche :
+   levels reçoit la somme préfixe (exclusive) locale, sums le total */
+static void prefix_task(int task, void *data)
+{
+	struct coloring *c = (struct coloring*) data;
+	const int first = c->nbBins*task/c->nbTasks, last = c->nbBins*(task+1)/c->nbTasks;
+	double sum = 0;
+	unsigned int count;
+	int b, k;
+	for (b = first; b < last; ++b) {
+		for (k = 0, count = 0; k < c->nbTasks; ++k)
+			count += c->partials[k][b];
+		c->levels[b] = sum;
+		sum += count;
+	}
+	c->sums[task] = sum;
+}
+
+/* Ajoute aux cases de la tâche le nombre de pixels des tranches précédentes
+   (sums contient alors la somme préfixe exclusive des tranches), et normalise */
+static void offset_task(int task, void *data)
+{
+	struct coloring *c = (struct coloring*) data;
+	const int first = c->nbBins*task/c->nbTasks, last = c->nbBins*(task+1)/c->nbTasks;
+	const double total = (c->sums[c->nbTasks] > 0) ? c->sums[c->nbTasks] : 1;
+	int b;
+	for (b = first; b < last; ++b)
+		c->levels[b] = (c->levels[b] + c->sums[task]) / total;
+}
+
+/* Lit dans la palette les couleurs des n index */
+static void lookup_colors(Uint32 *restrict pixel, const Uint32 *restrict palette,
+		const int *restrict indexes, int n)
+{
+	int x;
+	for (x = 0; x < n; ++x)
+		pixel[x] = palette[indexes[x]];
+}
+
+/* Colore les lignes de la tâche. Pour chaque ligne, les index de la palette 
+   sont calculés sans branchement, les points de l'ensemble (NBCOLOR, noir)
+   étant choisis par masque, puis les couleurs lues dans la palette. Les trois
+   boucles se vectorisent ; les lectures indexées (levels, palette) sont des
+   gather, natifs en AVX2 et émulés par des lectures scalaires en SSE2 */
+static void map_task(int task, void *data)
+{
+	struct coloring *c = (struct coloring*) data;
+	const int w = c->job->surface->w, h = c->job->surface->h;
+	const float nbMaxIt = c->job->nbMaxIt;
+	const int lastBin = c->nbBins-1;
+	const double binScale = c->binScale;
+	const double *restrict levels = c->levels;
+	const float *restrict values;
+	int *restrict indexes = (int*) malloc(w * sizeof(int));
+	double v, level;
+	int x, y, b, inSet;
+	for (y = h*task/c->nbTasks; y < h*(task+1)/c->nbTasks; ++y) {
+		values = c->job->channels[MANDELBROT_INDEX_ITERATIONS] + y*w;
+		if (c->mode == MANDELBROT_COLORING_EQUALIZED) {
+			for (x = 0; x < w; ++x) {
+				// position dans la case, interpolée entre ses bornes
+				v = values[x] * binScale;
+				b = (int) v;
+				b = (b < lastBin) ? b : lastBin;
+				level = levels[b] + (v - b)*(levels[b+1] - levels[b]);
+				inSet = -!(values[x] < nbMaxIt);
+				indexes[x] = ((int) (level*(NBCOLOR-1)) & ~inSet) | (NBCOLOR & inSet);
+			}
+		} else {
+			// hors de l'ensemble, values < nbMaxIt : l'index reste sous NBCOLOR
+			for (x = 0; x < w; ++x) {
+				inSet = -!(values[x] < nbMaxIt);
+				indexes[x] = ((int) (values[x] / nbMaxIt * NBCOLOR) & ~inSet) 
+					| (NBCOLOR & inSet);
+			}
+		}
+		lookup_colors((Uint32*) c->dst->pixels + y*(c->dst->pitch/4), c->palette,
+				indexes, w);
+	}
+	free(indexes);
+}
+
+/*********************************************/
+/***          FILE DES JOBS               ****/
+/*********************************************/
+
+/* Les fonctions suivantes sont appelées sous le verrou du moteur */
+
+/* Insère le job dans la file après les jobs de priorité supérieure ou égale */
+static void enqueue(struct mandelbrot_job *job)
+{
+	struct mandelbrot_job **prev = &queue;
+	while (*prev != NULL && (*prev)->priority >= job->priority)
+		prev = &(*prev)->next;
+	job->next = *prev;
+	*prev = job;
+}
+
+/* Retire le job de la file s'il y est encore */
+static void dequeue(struct mandelbrot_job *job)
+{
+	struct mandelbrot_job **prev = &queue;
+	while (*prev != NULL && *prev != job)
+		prev = &(*prev)->next;
+	if (*prev != NULL)
+		*prev = job->next;
+}
+
+/* Premier job de la file dont une ligne peut être distribuée (nombre 
+   maximal de threads non atteint), NULL s'il n'y en a pas */
+static struct mandelbrot_job *next_job()
+{
+	struct mandelbrot_job *job = queue;
+	while (job != NULL && job->maxWorkers > 0 && job->workers >= job->maxWorkers)
+		job = job->next;
+	return job;
+}
+
+/* Termine le job dont toutes les lignes distribuées sont calculées */
+static void finish(struct mandelbrot_job *job)
+{
+	free(job->lines);
+	free(job->mirrors);
+	job->lines = job->mirrors = NULL;
+	job->done = 1;
+	--unfinished_jobs;
+	if (job->callback != NULL)
+		job->callback(job, job->data);
+	pthread_cond_broadcast(&waiting);
+}
+
 /*********************************************/
 /***           THREAD LIVES               ****/
 /*********************************************/
@@ -143,10 +632,10 @@ static void *life_Of_Watcher(void *noargs)
 {
 	double avancee;
 	while(1) {
-		if (surface == NULL)
+		if (totalLines == 0)
 			avancee = 100;
 		else 
-			avancee = (double) (nextLine* 100) / surface->h;
+			avancee = (double) (distributedLines* 100) / totalLines;
 		if (display && (int) avancee < 100) {
 			printf("\rCalcul en cours... %2.1f %%             ", avancee);
 			fflush(stdout); // force affichage
@@ -156,28 +645,55 @@ static void *life_Of_Watcher(void *noargs)
 	return NULL;
 }
 
-/* La vie d'un thread de calcul... */
-static void *life_Of_Thread (void *noargs) 
+/* La vie d'un thread de calcul... 
+   Prend la prochaine ligne du premier job de la file qui l'accepte (voir 
+   maxWorkers). La fin de la ligne précédente est comptabilisée sous le 
+   même verrou. */
+static void *life_Of_Thread (void *arg) 
 {
+	const int index = (int) (long) arg;  // numéro du thread (threadTimes)
+	struct timeval start, end;
 	int task;
-	sem_wait(&working);
+	struct mandelbrot_job *job, *done = NULL;
 	while(1) {
 		pthread_mutex_lock(&mutex);
-		task = nextLine;
-		if (task == surface->h) {
-			// fin du calcul
-			++finished_jobs;
-			if (finished_jobs == nbThreads) // dernier thread
-				sem_post(&waiting);
+		if (done != NULL) {
+			--done->workers;
+			if (++done->doneLines == done->nbLines)
+				finish(done);
+			else if (done->maxWorkers > 0 && done->nextLine < done->nbLines)
+				pthread_cond_signal(&working);  // une place s'est libérée
+		}
+		while ((job = next_job()) == NULL && !stop)
+			pthread_cond_wait(&working, &mutex);
+		if (stop) {
 			pthread_mutex_unlock(&mutex);
-			sem_wait(&working);
-			continue;
+			return NULL;
+		}
+		// rendre prochaine tache disponible
+		task = job->nextLine++;
+		++job->workers;
+		++distributedLines;
+		if (job->nextLine == job->nbLines)
+			dequeue(job);
+		pthread_mutex_unlock(&mutex);
+		if (job->threadTimes != NULL)
+			gettimeofday(&start, NULL);
+		if (job->run != NULL) {
+			job->run(task, job->data);
+		} else if (job->lines == NULL) {
+			calc(job, task);
 		} else {
-			// rendre prochaine tache disponible
-			++nextLine;
-			pthread_mutex_unlock(&mutex);
+			calc(job, job->lines[task]);
+			if (job->mirrors[task] >= 0)
+				mirror(job, job->lines[task], job->mirrors[task]);
+		}
+		if (job->threadTimes != NULL) {
+			gettimeofday(&end, NULL);
+			job->threadTimes[index] += (end.tv_sec - start.tv_sec) 
+				+ (double) (end.tv_usec - start.tv_usec) / MICROSEC_IN_A_SEC;
 		}
-		calc(task);
+		done = job;
 	}
 	return NULL;
 }
@@ -192,15 +708,15 @@ void mandelbrot_init(int _nbThreads)
 
 	threads_id = (pthread_t*) malloc(nbThreads * sizeof(pthread_t));
 	pthread_mutex_init(&mutex, NULL);
-	sem_init(&working, 0, 0);
-	sem_init(&waiting, 0, 0);
+	pthread_cond_init(&working, NULL);
+	pthread_cond_init(&waiting, NULL);
 
 	int i;
 	if (pthread_create(&watcher, NULL, life_Of_Watcher, NULL)) {
 		printf("\nImpossible de créer un thread\n"); exit(EXIT_FAILURE);
 	}
 	for (i = 0; i < nbThreads; ++i) 
-		if (pthread_create(&threads_id[i], NULL, life_Of_Thread, NULL)) {
+		if (pthread_create(&threads_id[i], NULL, life_Of_Thread, (void*) (long) i)) {
 			printf("\nImpossible de créer un thread\n"); exit(EXIT_FAILURE);
 		}
 }
@@ -220,33 +736,242 @@ void mandelbrot_changeColors()
         init_color_table(GET_RANDOM_DOUBLE_BETWEEN(60, 360), GET_RANDOM_DOUBLE_BETWEEN(60, 360), 0.9, 0.9);
 }
 
+void mandelbrot_initJob(struct mandelbrot_job *job, struct bounds _bounds, 
+		struct complex _init, int _julia, int _nbMaxIt, SDL_Surface *_surface)
+{
+	int i;
+	job->bounds = _bounds;
+	job->init = _init;
+	job->julia = _julia;
+	job->nbMaxIt = _nbMaxIt;
+	job->surface = _surface;
+	job->priority = 0;
+	job->callback = NULL;
+	job->data = NULL;
+	job->done = job->cancelled = 0;
+	for (i = 0; i < MANDELBROT_NBCHANNELS; ++i)
+		job->channels[i] = NULL;
+	job->trap.real = job->trap.im = 0;
+	job->formula = MANDELBROT_FORMULA_Z2;
+	job->power = 2;
+	job->symmetry = MANDELBROT_SYMMETRY_DEFAULT;
+	job->costs = NULL;
+	job->predictedImbalance = 0;
+	job->threadTimes = NULL;
+	job->maxWorkers = 0;
+	job->run = NULL;
+}
+
 void mandelbrot_render(struct bounds _bounds, struct complex _init, 
 		int _julia, int _nbMaxIt, SDL_Surface *_surface) 
 {
-	struct timeval start, end;
+	struct mandelbrot_job job;
+	mandelbrot_initJob(&job, _bounds, _init, _julia, _nbMaxIt, _surface);
+	mandelbrot_renderJobs(&job, 1);
+}
+
+void mandelbrot_drawChannel(const struct mandelbrot_job *job, int channel,
+		SDL_Surface *dst)
+{
+	const int size = job->surface->w * job->surface->h;
+	float *values, min, max;
+	double v;
+	int i = 0, x, y;
+	Uint8 grey;
+	Uint32 *pixel;
+
+	while ((1 << i) != channel)
+		++i;
+	values = job->channels[i];
+	min = max = values[0];
+	for (x = 1; x < size; ++x) {
+		min = (values[x] < min) ? values[x] : min;
+		max = (values[x] > max) ? values[x] : max;
+	}
+	if (max == min)
+		max = min + 1;
+
+	for (y = 0; y < job->surface->h; ++y) {
+		pixel = (Uint32*) dst->pixels + y*(dst->pitch/4);
+		for (x = 0; x < job->surface->w; ++x) {
+			v = *values++;
+			if (channel == MANDELBROT_CHANNEL_DISTANCE) // distance en pixels, échelle log
+				v = log(1 + v/job->xIncr)/log(1 + DISTANCE_WHITE);
+			else if (channel == MANDELBROT_CHANNEL_TRAP)
+				v = (v - min)/(max - min);
+			else if (channel == MANDELBROT_CHANNEL_ITERATIONS)
+				v = v/job->nbMaxIt;
+			v = (v<0.0)?0.0:v;
+			v = (v>1.0)?1.0:v;
+			grey = (Uint8) (v*255);
+			pixel[x] = SDL_MapRGB(dst->format, grey, grey, grey);
+		}
+	}
+}
+
+void mandelbrot_colorize(const struct mandelbrot_job *job, int coloring, 
+		SDL_Surface *dst)
+{
+	struct coloring c;
+	double sum, tmp;
+	int i;
+
+	c.job = job;
+	c.dst = dst;
+	c.mode = coloring;
+	c.nbTasks = nbThreads;
+	pthread_mutex_lock(&mutex);
+	check_color_table(dst->format);
+	memcpy(c.palette, color_table, NBCOLOR * sizeof(Uint32));
+	pthread_mutex_unlock(&mutex);
+	c.palette[NBCOLOR] = SDL_MapRGB(dst->format, 0, 0, 0);
+
+	if (coloring == MANDELBROT_COLORING_EQUALIZED) {
+		c.nbBins = (job->nbMaxIt < COLORING_MAX_BINS) ? job->nbMaxIt : COLORING_MAX_BINS;
+		c.binScale = (double) c.nbBins / job->nbMaxIt;
+		c.partials = (Uint32**) malloc(c.nbTasks * sizeof(Uint32*));
+		for (i = 0; i < c.nbTasks; ++i)
+			c.partials[i] = (Uint32*) malloc(c.nbBins * sizeof(Uint32));
+		c.levels = (double*) malloc((c.nbBins+1) * sizeof(double));
+		c.sums = (double*) malloc((c.nbTasks+1) * sizeof(double));
+
+		mandelbrot_parallel(c.nbTasks, histogram_task, &c);
+		mandelbrot_parallel(c.nbTasks, prefix_task, &c);
+		// somme préfixe exclusive des tranches (une valeur par tâche)
+		for (i = 0, sum = 0; i < c.nbTasks; ++i) {
+			tmp = c.sums[i];
+			c.sums[i] = sum;
+			sum += tmp;
+		}
+		c.sums[c.nbTasks] = sum;
+		mandelbrot_parallel(c.nbTasks, offset_task, &c);
+		c.levels[c.nbBins] = 1;
+	}
+	mandelbrot_parallel(c.nbTasks, map_task, &c);
+
+	if (coloring == MANDELBROT_COLORING_EQUALIZED) {
+		for (i = 0; i < c.nbTasks; ++i)
+			free(c.partials[i]);
+		free(c.partials);
+		free(c.levels);
+		free(c.sums);
+	}
+}
+
+void mandelbrot_submit(struct mandelbrot_job *job)
+{
 	int i;
 
 	// Paramétrage moteur
-	gettimeofday(&start, NULL);
-	bounds = _bounds;
-	init = _init;
-	nbMaxIt = _nbMaxIt;
-	julia = _julia;
-	if (surface != _surface) {
-		surface = _surface;
-		init_color_table(0, 360, 0.9, 0.9);
+	job->channelMask = 0;
+	for (i = 0; i < MANDELBROT_NBCHANNELS; ++i)
+		if (job->channels[i] != NULL)
+			job->channelMask |= 1 << i;
+	job->xIncr = (job->bounds.xmax - job->bounds.xmin) / job->surface->w;
+	job->yIncr = (job->bounds.ymax - job->bounds.ymin) / job->surface->h;
+	job->nextLine = 0;
+	job->doneLines = 0;
+	job->workers = 0;
+	job->done = job->cancelled = 0;
+	plan_symmetry(job);
+	if (job->costs != NULL)
+		plan_costs(job);
+	if (job->threadTimes != NULL)
+		for (i = 0; i < nbThreads; ++i)
+			job->threadTimes[i] = 0;
+
+	pthread_mutex_lock(&mutex);
+	check_color_table(job->surface->format);
+	if (unfinished_jobs == 0)
+		totalLines = distributedLines = 0;
+	totalLines += job->nbLines;
+	++unfinished_jobs;
+	enqueue(job);
+	pthread_cond_broadcast(&working);  // reveille tous les threads travailleurs
+	pthread_mutex_unlock(&mutex);
+}
+
+void mandelbrot_wait(struct mandelbrot_job *job)
+{
+	pthread_mutex_lock(&mutex);
+	while (!job->done)                 // le dernier thread signalera waiting
+		pthread_cond_wait(&waiting, &mutex);
+	pthread_mutex_unlock(&mutex);
+}
+
+void mandelbrot_cancel(struct mandelbrot_job *job)
+{
+	pthread_mutex_lock(&mutex);
+	if (!job->done && !job->cancelled) {
+		job->cancelled = 1;
+		if (job->nextLine < job->nbLines) {
+			dequeue(job);
+			job->doneLines += job->nbLines - job->nextLine;
+			job->nextLine = job->nbLines;
+			if (job->doneLines == job->nbLines)
+				finish(job);
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+void mandelbrot_setPriority(struct mandelbrot_job *job, int priority)
+{
+	pthread_mutex_lock(&mutex);
+	job->priority = priority;
+	if (!job->done && job->nextLine < job->nbLines) {
+		dequeue(job);                  // la file reste triée par priorité
+		enqueue(job);
 	}
-	xIncr = (bounds.xmax - bounds.xmin) / surface->w;
-	yIncr = (bounds.ymax - bounds.ymin) / surface->h;
-	nextLine = 0;
-	finished_jobs = 0;
+	pthread_mutex_unlock(&mutex);
+}
+
+void mandelbrot_parallel(int nbTasks, void (*task)(int i, void *data), void *data)
+{
+	struct mandelbrot_job job;
+	if (nbTasks <= 0)
+		return;
+	job.priority = 0;
+	job.callback = NULL;
+	job.done = job.cancelled = 0;
+	job.threadTimes = NULL;
+	job.maxWorkers = job.workers = 0;
+	job.run = task;
+	job.data = data;
+	job.nbLines = nbTasks;
+	job.lines = job.mirrors = NULL;
+	job.nextLine = job.doneLines = 0;
+
+	pthread_mutex_lock(&mutex);
+	if (unfinished_jobs == 0)
+		totalLines = distributedLines = 0;
+	totalLines += nbTasks;
+	++unfinished_jobs;
+	enqueue(&job);
+	pthread_cond_broadcast(&working);
+	while (!job.done)
+		pthread_cond_wait(&waiting, &mutex);
+	pthread_mutex_unlock(&mutex);
+}
+
+int mandelbrot_getNbThreads()
+{
+	return nbThreads;
+}
+
+void mandelbrot_renderJobs(struct mandelbrot_job *jobs, int n)
+{
+	struct timeval start, end;
+	int i;
 
 	// Lancement des threads
-	for (i = 0; i < nbThreads; ++i)
-		sem_post(&working);  // reveille tous les threads travailleurs
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; ++i)
+		mandelbrot_submit(&jobs[i]);
 
 	// Attendre threads
-	sem_wait(&waiting);    // le dernier thread postera sur waiting
+	for (i = 0; i < n; ++i)
+		mandelbrot_wait(&jobs[i]);
 
 	// Affichage de fin
 	gettimeofday(&end, NULL);
@@ -260,14 +985,18 @@ void mandelbrot_render(struct bounds _bounds, struct complex _init,
 
 void mandelbrot_close()
 {
-	pthread_mutex_destroy(&mutex);
-	sem_destroy(&working);
-	sem_destroy(&waiting);
-
-	// annulation des threads
+	// arrêt des threads
 	pthread_cancel(watcher);
+	pthread_mutex_lock(&mutex);
+	stop = 1;
+	pthread_cond_broadcast(&working);
+	pthread_mutex_unlock(&mutex);
 	int i;
 	for (i = 0; i < nbThreads; ++i) 
-		pthread_cancel(threads_id[i]);
+		pthread_join(threads_id[i], NULL);
 	free(threads_id); 
+
+	pthread_mutex_destroy(&mutex);
+	pthread_cond_destroy(&working);
+	pthread_cond_destroy(&waiting);
 }
@@ -18,6 +18,115 @@ void mandelbrot_setDisplay(int boolean);
 /* Change les couleurs de la fractale au hasard */
 void mandelbrot_changeColors();
 
+/* Canaux supplémentaires, accumulés pendant les itérations du rendu :
+   - DISTANCE : estimation de la distance à l'ensemble (via la dérivée dz/dc)
+   - TRAP : distance minimale de l'orbite au point piège du job
+   - STRIPE : moyenne des stripes 0.5+0.5*sin(k*arg(z)) le long de l'orbite
+   - ITERATIONS : nombre d'itérations lissé (nbMaxIt pour les points de 
+     l'ensemble), conservé pour recolorer l'image sans recalcul 
+   Chaque canal a un indice (MANDELBROT_INDEX_*, buffer channels du job) et 
+   un drapeau (MANDELBROT_CHANNEL_*, 1 << indice) */
+#define MANDELBROT_INDEX_DISTANCE 0
+#define MANDELBROT_INDEX_TRAP 1
+#define MANDELBROT_INDEX_STRIPE 2
+#define MANDELBROT_INDEX_ITERATIONS 3
+#define MANDELBROT_CHANNEL_DISTANCE (1 << MANDELBROT_INDEX_DISTANCE)
+#define MANDELBROT_CHANNEL_TRAP (1 << MANDELBROT_INDEX_TRAP)
+#define MANDELBROT_CHANNEL_STRIPE (1 << MANDELBROT_INDEX_STRIPE)
+#define MANDELBROT_CHANNEL_ITERATIONS (1 << MANDELBROT_INDEX_ITERATIONS)
+#define MANDELBROT_NBCHANNELS 4
+
+/* Formules itérées (z0 = init et c = point pour Mandelbrot, 
+   z0 = point et c = init pour Julia) :
+   - Z2 : z^2 + c
+   - ZN : z^n + c, n = power du job
+   - BURNINGSHIP : (|Re z| + i|Im z|)^2 + c
+   - TRICORN : conj(z)^2 + c
+   - NEWTON : z - (z^3-1)/(3z^2) + c, itéré jusqu'à convergence (en mode
+     Mandelbrot z0 = 1 + init, point critique de la méthode)
+   L'estimation de distance est approchée pour BURNINGSHIP et TRICORN et
+   vaut 0 pour NEWTON */
+#define MANDELBROT_FORMULA_Z2 0
+#define MANDELBROT_FORMULA_ZN 1
+#define MANDELBROT_FORMULA_BURNINGSHIP 2
+#define MANDELBROT_FORMULA_TRICORN 3
+#define MANDELBROT_FORMULA_NEWTON 4
+#define MANDELBROT_NBFORMULAS 5
+#define MANDELBROT_FORMULA_NAMES {"z2", "zn", "burningship", "tricorn", "newton"}
+
+/* Demi-largeur du carré centré sur 0 qui montre en entier les ensembles de 
+   Julia intéressants de z^2 + c (aperçu du mode interactif, vignettes de 
+   l'atlas) */
+#define MANDELBROT_JULIA_EXTENT 1.8
+
+/* Tolérance par défaut (en fraction de ligne) de la symétrie, voir symmetry */
+#define MANDELBROT_SYMMETRY_DEFAULT 1e-3
+
+/* Job : un rendu à réaliser par le moteur
+   - bounds, init, julia, nbMaxIt, surface : voir mandelbrot_render
+   - priority : les lignes des jobs de plus forte priorité sont distribuées 
+     en premier (0 par défaut)
+   - callback : si non NULL, appelée avec data par le thread qui termine le job,
+     sous le verrou du moteur (elle ne doit donc pas appeler le moteur)
+   - done, cancelled : job terminé (1) ? annulé avant la fin (1) ?
+   - channels : buffers (largeur*hauteur valeurs, ligne par ligne) des canaux
+     supplémentaires (channels[MANDELBROT_INDEX_*]), NULL si inactif
+   - trap : point piège du canal TRAP (0 par défaut)
+   - formula : formule itérée (MANDELBROT_FORMULA_*, Z2 par défaut)
+   - power : exposant de la formule ZN (entier >= 2)
+   - symmetry : si l'image est symétrique par rapport à l'axe réel et que
+     celui-ci la traverse, seule la plus grande moitié est calculée et ses 
+     lignes sont recopiées sur leur reflet. Il faut pour cela que les reflets
+     tombent sur des lignes de l'image à symmetry près (en fraction de ligne).
+     Une valeur négative désactive la symétrie.
+   - costs : si non NULL, coût prévu de chaque ligne (hauteur valeurs, dans 
+     une unité quelconque) : les lignes sont distribuées de la plus coûteuse 
+     à la moins coûteuse, et predictedImbalance reçoit à la soumission le 
+     déséquilibre prévu entre threads (temps du thread le plus chargé sur le 
+     temps moyen, moins 1)
+   - threadTimes : si non NULL (une valeur par thread du moteur), reçoit le 
+     temps (en secondes) passé par chaque thread à calculer les lignes du job
+   - maxWorkers : si > 0, nombre maximal de threads calculant en même temps 
+     des lignes du job (0 par défaut : tous). Un job de faible priorité 
+     limité ainsi laisse toujours les autres threads libres pour les jobs 
+     prioritaires soumis pendant son calcul
+   Les champs suivants sont réservés au moteur */
+struct mandelbrot_job {
+	struct bounds bounds;
+	struct complex init;
+	int julia;
+	int nbMaxIt;
+	SDL_Surface *surface;
+	int priority;
+	void (*callback)(struct mandelbrot_job *job, void *data);
+	void *data;
+	int done, cancelled;
+	float *channels[MANDELBROT_NBCHANNELS];
+	struct complex trap;
+	int formula;
+	int power;
+	double symmetry;
+	const float *costs;
+	double predictedImbalance;
+	double *threadTimes;
+	int maxWorkers;
+
+	int channelMask;                 // canaux actifs (MANDELBROT_CHANNEL_*)
+	double xIncr, yIncr;             // distance entre deux points de l'espace
+	void (*run)(int task, void *data); // tâche générique (mandelbrot_parallel)
+	int nbLines;                     // nombre de lignes à calculer
+	int *lines, *mirrors;            // lignes à calculer et leurs reflets (symétrie)
+	int nextLine;                    // prochaine ligne à distribuer
+	int doneLines;                   // nombre de lignes calculées
+	int workers;                     // threads calculant une ligne du job
+	struct mandelbrot_job *next;     // job suivant dans la file du moteur
+};
+
+/* Initialise un job avec les paramètres donnés (voir mandelbrot_render)
+   et les valeurs par défaut des autres champs */
+void mandelbrot_initJob(struct mandelbrot_job *job, struct bounds _bounds, 
+		struct complex _init, int _julia, int _nbMaxIt, SDL_Surface *_surface);
+
 /* Réalise le rendu de l'ensemble de Mandelbrot ou de Julia dans la surface s
    - _bounds : bornes de l'espace
    - _init : complexe initialisateur - c (Julia) ou z0 (Mandelbrot)
@@ -27,6 +136,55 @@ void mandelbrot_changeColors();
 void mandelbrot_render(struct bounds _bounds, struct complex _init, 
 		int _julia, int _nbMaxIt, SDL_Surface *_surface); 
 
+/* Réalise les n rendus décrits par jobs en une seule fois
+   Les lignes de tous les jobs sont distribuées aux mêmes threads : plusieurs 
+   petites images occupent ainsi tout le pool, sans attente entre deux rendus.
+   Les surfaces doivent être distinctes. */
+void mandelbrot_renderJobs(struct mandelbrot_job *jobs, int n);
+
+/* Dessine en niveaux de gris le canal (MANDELBROT_CHANNEL_*) d'un job terminé
+   dans dst, de même dimension que la surface du job */
+void mandelbrot_drawChannel(const struct mandelbrot_job *job, int channel,
+		SDL_Surface *dst);
+
+/* Colorations (mandelbrot_colorize) :
+   - LINEAR : couleur proportionnelle au nombre d'itérations, comme au rendu
+   - EQUALIZED : égalisation d'histogramme, chaque couleur de la palette 
+     couvre autant de pixels, quel que soit nbMaxIt */
+#define MANDELBROT_COLORING_LINEAR 0
+#define MANDELBROT_COLORING_EQUALIZED 1
+
+/* Recolore dans dst (de même dimension que la surface du job) un job terminé
+   rendu avec le canal ITERATIONS, avec la palette courante et sans refaire les 
+   itérations. La couleur ne dépend que des itérations : pour NEWTON, la 
+   racine atteinte est perdue. Les tâches sont réparties sur les threads du 
+   moteur (voir mandelbrot_parallel) */
+void mandelbrot_colorize(const struct mandelbrot_job *job, int coloring, 
+		SDL_Surface *dst);
+
+/* Soumet un job au moteur sans attendre la fin du rendu
+   Le job et sa surface doivent rester valides jusqu'à la fin du job */
+void mandelbrot_submit(struct mandelbrot_job *job);
+
+/* Attend la fin d'un job soumis */
+void mandelbrot_wait(struct mandelbrot_job *job);
+
+/* Annule un job soumis : ses lignes non distribuées ne seront pas calculées
+   Le job se termine (done, callback) dès que ses lignes en cours sont finies */
+void mandelbrot_cancel(struct mandelbrot_job *job);
+
+/* Change la priorité d'un job soumis : ses lignes non encore distribuées 
+   reprennent place dans la file du moteur selon la nouvelle priorité */
+void mandelbrot_setPriority(struct mandelbrot_job *job, int priority);
+
+/* Exécute task(i, data) pour i de 0 à nbTasks-1 sur les threads du moteur
+   et attend la fin de toutes les tâches. Les tâches d'indices différents 
+   peuvent s'exécuter en parallèle (aucune ne doit appeler le moteur). */
+void mandelbrot_parallel(int nbTasks, void (*task)(int i, void *data), void *data);
+
+/* Nombre de threads de calcul du moteur */
+int mandelbrot_getNbThreads();
+
 /* Libère les données du moteur */
 void mandelbrot_close();
 
@@ -15,6 +15,24 @@ static const char *options_pictureName = PICTURENAME_DEFAULT;
 static int options_captureMode = CAPTUREMODE_DEFAULT;
 static double options_captureZoomSpeed = CAPTUREZOOMSPEED_DEFAULT;
 static int options_captureNbFrames = CAPTURENBFRAMES_DEFAULT;
+static int options_tilesMode = TILESMODE_DEFAULT;
+static int options_tilesMaxZoom = TILESMAXZOOM_DEFAULT;
+static const char *options_batchFile = BATCHFILE_DEFAULT;
+static const char *options_serverAddress = SERVERADDRESS_DEFAULT;
+static int options_channels = CHANNELS_DEFAULT;
+static int options_formula = FORMULA_DEFAULT;
+static int options_power = POWER_DEFAULT;
+static double options_symmetry = SYMMETRY_DEFAULT;
+static int options_buddhabrot = BUDDHABROT_DEFAULT;
+static const char *options_sweepPath = SWEEPPATH_DEFAULT;
+static int options_sweepNbFrames = SWEEPNBFRAMES_DEFAULT;
+static double options_fps = FPS_DEFAULT;
+static int options_equalize = EQUALIZE_DEFAULT;
+static int options_predict = PREDICT_DEFAULT;
+static int options_preview = PREVIEW_DEFAULT;
+static int options_atlasColumns = ATLASCOLUMNS_DEFAULT;
+static int options_atlasRows = ATLASROWS_DEFAULT;
+static int options_atlasSize = ATLASSIZE_DEFAULT;
 
 void options_check()
 {
@@ -37,6 +55,9 @@ void options_check()
 	if (options_nbMaxIt < NBMAXIT_MIN) {
 		printf("\nNombre minimal d'itérations non respecté\n"); exit(EXIT_FAILURE);
 	}
+	if (options_power < POWER_MIN) {
+		printf("\nExposant de la formule incorrect\n"); exit(EXIT_FAILURE);
+	}
 	if (options_captureZoomSpeed <= 0.0) {
 		printf("\nVitesse de zoom incorrecte\n"); exit(EXIT_FAILURE);
 	}
@@ -46,6 +67,57 @@ void options_check()
 	if (options_photoMode && options_captureMode) {
 		printf("\nLes modes photos et capture sont incompatibles\n"); exit(EXIT_FAILURE);
 	}
+	if (options_tilesMaxZoom < 0 || options_tilesMaxZoom > TILESMAXZOOM_MAX) {
+		printf("\nNiveau de zoom maximal des tuiles incorrect\n"); exit(EXIT_FAILURE);
+	}
+	if (options_tilesMode && (options_photoMode || options_captureMode)) {
+		printf("\nLe mode tuiles est incompatible avec les modes photo et capture\n"); exit(EXIT_FAILURE);
+	}
+	if (options_batchFile != NULL 
+			&& (options_photoMode || options_captureMode || options_tilesMode)) {
+		printf("\nLe mode batch est incompatible avec les modes photo, capture et tuiles\n"); exit(EXIT_FAILURE);
+	}
+	if (options_serverAddress != NULL && (options_photoMode || options_captureMode 
+				|| options_tilesMode || options_batchFile != NULL)) {
+		printf("\nLe mode serveur est incompatible avec les autres modes\n"); exit(EXIT_FAILURE);
+	}
+	if (options_buddhabrot < 0) {
+		printf("\nNombre de tirages incorrect\n"); exit(EXIT_FAILURE);
+	}
+	if (options_buddhabrot && (options_photoMode || options_captureMode || options_tilesMode 
+				|| options_batchFile != NULL || options_serverAddress != NULL)) {
+		printf("\nLe mode buddhabrot est incompatible avec les autres modes\n"); exit(EXIT_FAILURE);
+	}
+	if (options_buddhabrot && options_formula != FORMULA_DEFAULT) {
+		printf("\nLe mode buddhabrot n'accepte que la formule z2\n"); exit(EXIT_FAILURE);
+	}
+	if (options_fps <= 0.0) {
+		printf("\nCadence incorrecte\n"); exit(EXIT_FAILURE);
+	}
+	if (options_sweepNbFrames < 1) {
+		printf("\nNombre d'images incorrect\n"); exit(EXIT_FAILURE);
+	}
+	if (options_sweepPath != NULL && (options_photoMode || options_captureMode 
+				|| options_tilesMode || options_batchFile != NULL 
+				|| options_serverAddress != NULL || options_buddhabrot)) {
+		printf("\nLe mode balayage est incompatible avec les autres modes\n"); exit(EXIT_FAILURE);
+	}
+	if (options_atlasColumns < 0 || options_atlasRows < 0 
+			|| (options_atlasColumns > 0) != (options_atlasRows > 0)) {
+		printf("\nGrille de l'atlas incorrecte\n"); exit(EXIT_FAILURE);
+	}
+	if (options_atlasSize < ATLASSIZE_MIN) {
+		printf("\nTaille des vignettes de l'atlas trop petite\n"); exit(EXIT_FAILURE);
+	}
+	if (options_atlasColumns && (options_photoMode || options_captureMode 
+				|| options_tilesMode || options_batchFile != NULL 
+				|| options_serverAddress != NULL || options_buddhabrot
+				|| options_sweepPath != NULL)) {
+		printf("\nLe mode atlas est incompatible avec les autres modes\n"); exit(EXIT_FAILURE);
+	}
+	if (options_atlasColumns && options_formula != FORMULA_DEFAULT) {
+		printf("\nLe mode atlas n'accepte que la formule z2\n"); exit(EXIT_FAILURE);
+	}
 }
 
 /*********************************************/
@@ -111,6 +183,88 @@ void options_setCaptureNbFrames(int n)
 	options_captureNbFrames = n;
 }
 
+void options_setTilesMode(int boolean)
+{
+	options_tilesMode = boolean;
+}
+
+void options_setTilesMaxZoom(int z)
+{
+	options_tilesMaxZoom = z;
+}
+
+void options_setBatchFile(const char *name)
+{
+	options_batchFile = name;
+}
+
+void options_setServerAddress(const char *address)
+{
+	options_serverAddress = address;
+}
+
+void options_setChannels(int mask)
+{
+	options_channels = mask;
+}
+
+void options_setFormula(int formula)
+{
+	options_formula = formula;
+}
+
+void options_setPower(int n)
+{
+	options_power = n;
+}
+
+void options_setSymmetry(double tolerance)
+{
+	options_symmetry = tolerance;
+}
+
+void options_setBuddhabrot(int millions)
+{
+	options_buddhabrot = millions;
+}
+
+void options_setSweepPath(const char *path)
+{
+	options_sweepPath = path;
+}
+
+void options_setSweepNbFrames(int n)
+{
+	options_sweepNbFrames = n;
+}
+
+void options_setFps(double fps)
+{
+	options_fps = fps;
+}
+
+void options_setEqualize(int boolean)
+{
+	options_equalize = boolean;
+}
+
+void options_setPredict(int boolean)
+{
+	options_predict = boolean;
+}
+
+void options_setPreview(int boolean)
+{
+	options_preview = boolean;
+}
+
+void options_setAtlas(int cols, int rows, int size)
+{
+	options_atlasColumns = cols;
+	options_atlasRows = rows;
+	options_atlasSize = size;
+}
+
 /*********************************************/
 /*******         ACCESSEURS        ***********/
 /*********************************************/
@@ -173,3 +327,93 @@ int options_getCaptureNbFrames()
 {
 	return options_captureNbFrames;
 }
+
+int options_getTilesMode()
+{
+	return options_tilesMode;
+}
+
+int options_getTilesMaxZoom()
+{
+	return options_tilesMaxZoom;
+}
+
+const char *options_getBatchFile()
+{
+	return options_batchFile;
+}
+
+const char *options_getServerAddress()
+{
+	return options_serverAddress;
+}
+
+int options_getChannels()
+{
+	return options_channels;
+}
+
+int options_getFormula()
+{
+	return options_formula;
+}
+
+int options_getPower()
+{
+	return options_power;
+}
+
+double options_getSymmetry()
+{
+	return options_symmetry;
+}
+
+int options_getBuddhabrot()
+{
+	return options_buddhabrot;
+}
+
+const char *options_getSweepPath()
+{
+	return options_sweepPath;
+}
+
+int options_getSweepNbFrames()
+{
+	return options_sweepNbFrames;
+}
+
+double options_getFps()
+{
+	return options_fps;
+}
+
+int options_getEqualize()
+{
+	return options_equalize;
+}
+
+int options_getPredict()
+{
+	return options_predict;
+}
+
+int options_getPreview()
+{
+	return options_preview;
+}
+
+int options_getAtlasColumns()
+{
+	return options_atlasColumns;
+}
+
+int options_getAtlasRows()
+{
+	return options_atlasRows;
+}
+
+int options_getAtlasSize()
+{
+	return options_atlasSize;
+}
@@ -1,6 +1,7 @@
 #ifndef OPTIONS_H
 #define OPTIONS_H
 
+#include "mandelbrot.h"
 #include "types.h"
 
 #define DIMENSION_MIN {128, 128}
@@ -19,6 +20,27 @@
 #define CAPTUREMODE_DEFAULT 0
 #define CAPTUREZOOMSPEED_DEFAULT 100.0
 #define CAPTURENBFRAMES_DEFAULT 150
+#define TILESMODE_DEFAULT 0
+#define TILESMAXZOOM_DEFAULT 4
+#define TILESMAXZOOM_MAX 14
+#define BATCHFILE_DEFAULT NULL
+#define SERVERADDRESS_DEFAULT NULL
+#define CHANNELS_DEFAULT 0
+#define FORMULA_DEFAULT 0          // z^2 + c
+#define POWER_DEFAULT 2
+#define POWER_MIN 2
+#define SYMMETRY_DEFAULT MANDELBROT_SYMMETRY_DEFAULT  // fraction de ligne
+#define BUDDHABROT_DEFAULT 0        // millions de tirages, 0 : désactivé
+#define SWEEPPATH_DEFAULT NULL
+#define SWEEPNBFRAMES_DEFAULT 150
+#define FPS_DEFAULT 25.0
+#define EQUALIZE_DEFAULT 0
+#define PREDICT_DEFAULT 0
+#define PREVIEW_DEFAULT 0
+#define ATLASCOLUMNS_DEFAULT 0      // 0 : mode atlas désactivé
+#define ATLASROWS_DEFAULT 0
+#define ATLASSIZE_DEFAULT 64
+#define ATLASSIZE_MIN 16
 
 /* Module de gestion des options du programme (arguments) */
 
@@ -38,6 +60,22 @@ void options_setPictureName(const char *name);
 void options_setCaptureMode(int boolean);
 void options_setCaptureZoomSpeed(double s);
 void options_setCaptureNbFrames(int n);
+void options_setTilesMode(int boolean);
+void options_setTilesMaxZoom(int z);
+void options_setBatchFile(const char *name);
+void options_setServerAddress(const char *address);
+void options_setChannels(int mask);
+void options_setFormula(int formula);
+void options_setPower(int n);
+void options_setSymmetry(double tolerance);
+void options_setBuddhabrot(int millions);
+void options_setSweepPath(const char *path);
+void options_setSweepNbFrames(int n);
+void options_setFps(double fps);
+void options_setEqualize(int boolean);
+void options_setPredict(int boolean);
+void options_setPreview(int boolean);
+void options_setAtlas(int cols, int rows, int size);
 
 /* Accesseurs */
 struct dimension options_getDimension();
@@ -52,5 +90,23 @@ const char *options_getPictureName();
 int options_getCaptureMode();
 double options_getCaptureZoomSpeed();
 int options_getCaptureNbFrames();
+int options_getTilesMode();
+int options_getTilesMaxZoom();
+const char *options_getBatchFile();
+const char *options_getServerAddress();
+int options_getChannels();
+int options_getFormula();
+int options_getPower();
+double options_getSymmetry();
+int options_getBuddhabrot();
+const char *options_getSweepPath();
+int options_getSweepNbFrames();
+double options_getFps();
+int options_getEqualize();
+int options_getPredict();
+int options_getPreview();
+int options_getAtlasColumns();
+int options_getAtlasRows();
+int options_getAtlasSize();
 
 #endif
@@ -0,0 +1,523 @@
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "server.h"
+
+// Compilation conditionnelle : sockets BSD uniquement
+#ifdef WIN32
+
+void server_run(const char *address)
+{
+	printf("\nMode serveur non disponible sous windows\n"); exit(EXIT_FAILURE);
+}
+
+#else
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "mandelbrot.h"
+#include "options.h"
+
+#define COLOR_DEPTH 32            // couleurs 32 bits
+#define SERVER_MAX_CLIENTS 64
+#define SERVER_LINE_MAX 1024
+#define SERVER_ID_MAX 64
+#define SERVER_OUTPUT_MAX (64 << 20)  // octets en attente d'envoi par client
+
+/*********************************************/
+/*******    VARIABLES DU MODULE    ***********/
+/*********************************************/
+
+/* Client connecté (socket non bloquante)
+   Les réponses sont ajoutées à son tampon de sortie, vidé au fur et à 
+   mesure que la socket accepte des données : un client lent ne bloque 
+   jamais la boucle principale */
+struct client {
+	int fd;                        // -1 si emplacement libre
+	char line[SERVER_LINE_MAX];    // ligne en cours de réception
+	int length;
+	char *out;                     // tampon de sortie
+	size_t outStart, outLength;    // début et taille des données à envoyer
+	size_t outSize;                // taille allouée du tampon
+	int broken;                    // erreur d'écriture : client à fermer
+};
+
+/* Client attendant le résultat d'un rendu */
+struct waiter {
+	struct client *client;
+	char id[SERVER_ID_MAX];
+	int rle;                       // réponse compressée (1) ou brute (0) ?
+	int priority;                  // priorité demandée par le client
+	struct waiter *next;
+};
+
+/* Rendu en cours, partagé par toutes les requêtes identiques */
+struct request {
+	struct mandelbrot_job job;
+	struct waiter *waiters;
+	struct request *next;
+};
+
+static int listenFd;
+static int notifyPipe[2];         // le moteur y écrit les requêtes terminées
+static struct client clients[SERVER_MAX_CLIENTS];
+static struct request *requests;  // requêtes soumises au moteur
+static int running;
+
+/*********************************************/
+/*******          UTILITAIRES      ***********/
+/*********************************************/
+
+/* Envoie ce que la socket accepte du tampon de sortie, sans bloquer */
+static void flush_client(struct client *client)
+{
+	ssize_t n;
+	while (client->outLength > 0) {
+		n = write(client->fd, client->out + client->outStart, client->outLength);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (n <= 0) {
+			client->broken = 1;
+			client->outLength = 0;
+		} else {
+			client->outStart += n;
+			client->outLength -= n;
+		}
+	}
+	if (client->outLength == 0)
+		client->outStart = 0;
+}
+
+/* Ajoute size octets au tampon de sortie du client et en envoie ce qui
+   peut l'être immédiatement. Un client qui laisse s'accumuler plus de 
+   SERVER_OUTPUT_MAX octets sans les lire est abandonné (une seule réponse 
+   plus grande reste acceptée si rien d'autre n'est en attente) */
+static void send_all(struct client *client, const void *buffer, size_t size)
+{
+	if (client->broken)
+		return;
+	if (client->outLength > 0 && client->outLength + size > SERVER_OUTPUT_MAX) {
+		client->broken = 1;
+		client->outLength = 0;
+		return;
+	}
+	if (client->outStart + client->outLength + size > client->outSize) {
+		memmove(client->out, client->out + client->outStart, client->outLength);
+		client->outStart = 0;
+	}
+	if (client->outLength + size > client->outSize) {
+		client->outSize = 2*client->outSize > client->outLength + size ?
+			2*client->outSize : client->outLength + size;
+		client->out = (char*) realloc(client->out, client->outSize);
+		if (client->out == NULL) {
+			printf("\nMémoire insuffisante pour les réponses\n"); exit(EXIT_FAILURE);
+		}
+	}
+	memcpy(client->out + client->outStart + client->outLength, buffer, size);
+	client->outLength += size;
+	flush_client(client);
+}
+
+static void send_line(struct client *client, const char *line)
+{
+	send_all(client, line, strlen(line));
+}
+
+/* Appelée par le moteur à la fin d'un job : réveille la boucle principale
+   L'écriture d'un pointeur (moins de PIPE_BUF octets) est atomique ; elle ne
+   bloque que si le tube est plein, la boucle principale le vidant à chaque 
+   réveil */
+static void job_done(struct mandelbrot_job *job, void *data)
+{
+	ssize_t n;
+	do
+		n = write(notifyPipe[1], &data, sizeof(data));
+	while (n < 0 && errno == EINTR);
+	if (n != sizeof(data)) {
+		printf("\nImpossible de signaler la fin d'un rendu\n"); exit(EXIT_FAILURE);
+	}
+}
+
+/* Ouvre la socket d'écoute : port TCP local ou chemin de socket unix */
+static int open_socket(const char *address)
+{
+	struct stat st;
+	int fd, one = 1;
+	if (strspn(address, "0123456789") == strlen(address)) {
+		struct sockaddr_in sin;
+		memset(&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons(atoi(address));
+		sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, (struct sockaddr*) &sin, sizeof(sin)) < 0)
+			return -1;
+	} else {
+		struct sockaddr_un sun;
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		strncpy(sun.sun_path, address, sizeof(sun.sun_path) - 1);
+		// seule une socket laissée par un serveur précédent est remplacée
+		if (stat(address, &st) == 0 && S_ISSOCK(st.st_mode))
+			unlink(address);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0 || bind(fd, (struct sockaddr*) &sun, sizeof(sun)) < 0)
+			return -1;
+	}
+	if (listen(fd, SERVER_MAX_CLIENTS) < 0)
+		return -1;
+	return fd;
+}
+
+/*********************************************/
+/*******           REQUETES        ***********/
+/*********************************************/
+
+/* Vrai si les deux jobs produisent la même image */
+static int same_view(const struct mandelbrot_job *a, const struct mandelbrot_job *b)
+{
+	return a->bounds.xmin == b->bounds.xmin && a->bounds.xmax == b->bounds.xmax
+		&& a->bounds.ymin == b->bounds.ymin && a->bounds.ymax == b->bounds.ymax
+		&& a->init.real == b->init.real && a->init.im == b->init.im
+		&& a->julia == b->julia && a->nbMaxIt == b->nbMaxIt
+		&& a->surface->w == b->surface->w && a->surface->h == b->surface->h;
+}
+
+/* Envoie l'image rendue au client en attente */
+static void send_result(struct waiter *w, SDL_Surface *s)
+{
+	char header[SERVER_LINE_MAX];
+	Uint32 *data, *pixel;
+	size_t size = 0;
+	int x, y;
+
+	data = (Uint32*) malloc((w->rle ? 2 : 1) * s->w * s->h * sizeof(Uint32));
+	for (y = 0; y < s->h; ++y) {
+		pixel = (Uint32*) s->pixels + y*(s->pitch/4);
+		for (x = 0; x < s->w; ++x) {
+			if (!w->rle) {
+				data[size++] = pixel[x];
+			} else if (size > 0 && data[size-1] == pixel[x]) {
+				++data[size-2];
+			} else {
+				data[size++] = 1;
+				data[size++] = pixel[x];
+			}
+		}
+	}
+	size *= sizeof(Uint32);
+	sprintf(header, "ok %s %d %d %s %lu\n", w->id, s->w, s->h,
+			w->rle ? "rle" : "raw", (unsigned long) size);
+	send_all(w->client, header, strlen(header));
+	send_all(w->client, data, size);
+	free(data);
+}
+
+/* Retire la requête terminée de la liste et répond à ses clients */
+static void complete(struct request *r)
+{
+	struct request **prev = &requests;
+	struct waiter *w;
+	while (*prev != r)
+		prev = &(*prev)->next;
+	*prev = r->next;
+
+	while ((w = r->waiters) != NULL) {
+		if (!r->job.cancelled)
+			send_result(w, r->job.surface);
+		r->waiters = w->next;
+		free(w);
+	}
+	SDL_FreeSurface(r->job.surface);
+	free(r);
+}
+
+/* Termine toutes les requêtes signalées par le moteur (tube non bloquant) */
+static void read_notifications()
+{
+	struct request *r;
+	ssize_t n;
+	while ((n = read(notifyPipe[0], &r, sizeof(r))) == sizeof(r) 
+			|| (n < 0 && errno == EINTR))
+		if (n > 0)
+			complete(r);
+}
+
+/* Donne au rendu la plus forte priorité des clients qui l'attendent */
+static void update_priority(struct request *r)
+{
+	struct waiter *w;
+	int priority = r->waiters->priority;
+	for (w = r->waiters->next; w != NULL; w = w->next)
+		if (w->priority > priority)
+			priority = w->priority;
+	if (priority != r->job.priority)
+		mandelbrot_setPriority(&r->job, priority);
+}
+
+/* Retire l'attente de id (tous les ids si id vaut NULL) du client
+   Les rendus que plus personne n'attend sont annulés, les autres gardent la
+   plus forte priorité des attentes restantes */
+static void remove_waiters(struct client *client, const char *id)
+{
+	struct request *r;
+	struct waiter **prev, *w;
+	int removed;
+	for (r = requests; r != NULL; r = r->next) {
+		removed = 0;
+		prev = &r->waiters;
+		while ((w = *prev) != NULL) {
+			if (w->client == client && (id == NULL || strcmp(w->id, id) == 0)) {
+				if (id != NULL) {
+					char line[SERVER_LINE_MAX];
+					sprintf(line, "cancelled %s\n", id);
+					send_line(client, line);
+				}
+				*prev = w->next;
+				free(w);
+				removed = 1;
+			} else {
+				prev = &w->next;
+			}
+		}
+		if (r->waiters == NULL)
+			mandelbrot_cancel(&r->job);
+		else if (removed)
+			update_priority(r);
+	}
+}
+
+/* Traite une commande "render" */
+static void render(struct client *client, const char *line)
+{
+	char id[SERVER_ID_MAX], format[8], error[SERVER_LINE_MAX];
+	struct bounds b;
+	struct complex init;
+	int priority, width, height, julia, nbMaxIt;
+	struct request *r;
+	struct waiter *w;
+
+	if (sscanf(line, "render %63s %d %d %d %lf %lf %lf %lf %lf %lf %d %d %7s",
+				id, &priority, &width, &height, &b.xmin, &b.xmax, &b.ymin, &b.ymax,
+				&init.real, &init.im, &julia, &nbMaxIt, format) != 13
+			|| width <= 0 || height <= 0 || b.xmin >= b.xmax || b.ymin >= b.ymax
+			|| nbMaxIt < NBMAXIT_MIN
+			|| (strcmp(format, "raw") != 0 && strcmp(format, "rle") != 0)) {
+		sprintf(error, "error %s requete incorrecte\n",
+				sscanf(line, "render %63s", id) == 1 ? id : "-");
+		send_line(client, error);
+		return;
+	}
+
+	w = (struct waiter*) malloc(sizeof(struct waiter));
+	w->client = client;
+	strcpy(w->id, id);
+	w->rle = strcmp(format, "rle") == 0;
+	w->priority = priority;
+
+	r = (struct request*) malloc(sizeof(struct request));
+	r->job.surface = SDL_CreateRGBSurface(0, width, height, COLOR_DEPTH,
+			0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+	if (r->job.surface == NULL) {
+		sprintf(error, "error %s surface indisponible\n", id);
+		send_line(client, error);
+		free(r); free(w);
+		return;
+	}
+	mandelbrot_initJob(&r->job, b, init, julia, nbMaxIt, r->job.surface);
+	r->job.formula = options_getFormula();
+	r->job.power = options_getPower();
+	r->job.symmetry = options_getSymmetry();
+
+	// regroupement avec un rendu identique en cours
+	struct request *same;
+	for (same = requests; same != NULL; same = same->next)
+		if (!same->job.cancelled && same_view(&same->job, &r->job))
+			break;
+	w->next = NULL;
+	if (same != NULL) {
+		struct waiter **last = &same->waiters;
+		while (*last != NULL)
+			last = &(*last)->next;
+		*last = w;
+		update_priority(same);
+		SDL_FreeSurface(r->job.surface);
+		free(r);
+		return;
+	}
+
+	r->waiters = w;
+	r->next = requests;
+	requests = r;
+	r->job.priority = priority;
+	r->job.callback = job_done;
+	r->job.data = r;
+	mandelbrot_submit(&r->job);
+}
+
+/* Traite une ligne reçue d'un client */
+static void treat_line(struct client *client, const char *line)
+{
+	char id[SERVER_ID_MAX];
+	if (strncmp(line, "render ", 7) == 0) {
+		render(client, line);
+	} else if (sscanf(line, "cancel %63s", id) == 1) {
+		remove_waiters(client, id);
+	} else if (strcmp(line, "quit") == 0) {
+		running = 0;
+	} else if (line[0] != '\0') {
+		send_line(client, "error - commande inconnue\n");
+	}
+}
+
+/*********************************************/
+/*******            CLIENTS        ***********/
+/*********************************************/
+
+static void accept_client()
+{
+	int i, fd = accept(listenFd, NULL, NULL);
+	if (fd < 0)
+		return;
+	for (i = 0; i < SERVER_MAX_CLIENTS; ++i)
+		if (clients[i].fd < 0) {
+			fcntl(fd, F_SETFL, O_NONBLOCK);
+			clients[i].fd = fd;
+			clients[i].length = 0;
+			clients[i].out = NULL;
+			clients[i].outStart = clients[i].outLength = clients[i].outSize = 0;
+			clients[i].broken = 0;
+			return;
+		}
+	close(fd); // trop de clients
+}
+
+static void close_client(struct client *client)
+{
+	remove_waiters(client, NULL);
+	close(client->fd);
+	free(client->out);
+	client->out = NULL;
+	client->fd = -1;
+}
+
+/* Lit les données disponibles et traite les lignes complètes */
+static void read_client(struct client *client)
+{
+	char *end;
+	int n = read(client->fd, client->line + client->length,
+			SERVER_LINE_MAX - 1 - client->length);
+	if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+		return;
+	if (n <= 0) {
+		close_client(client);
+		return;
+	}
+	client->length += n;
+	client->line[client->length] = '\0';
+	while ((end = strchr(client->line, '\n')) != NULL) {
+		*end = '\0';
+		if (end > client->line && end[-1] == '\r')
+			end[-1] = '\0';
+		treat_line(client, client->line);
+		client->length -= end + 1 - client->line;
+		memmove(client->line, end + 1, client->length + 1);
+		if (client->fd < 0)
+			return;
+	}
+	if (client->length == SERVER_LINE_MAX - 1) {
+		send_line(client, "error - ligne trop longue\n");
+		client->length = 0;
+	}
+}
+
+/*********************************************/
+/*******       PUBLIC FUNCTIONS    ***********/
+/*********************************************/
+
+void server_run(const char *address)
+{
+	fd_set fds, writeFds;
+	int i, maxFd;
+
+	listenFd = open_socket(address);
+	if (listenFd < 0 || pipe(notifyPipe) < 0) {
+		printf("\nImpossible d'écouter sur \"%s\"\n", address); exit(EXIT_FAILURE);
+	}
+	fcntl(notifyPipe[0], F_SETFL, O_NONBLOCK);
+	signal(SIGPIPE, SIG_IGN);  // un client disparu ne doit pas tuer le serveur
+	for (i = 0; i < SERVER_MAX_CLIENTS; ++i)
+		clients[i].fd = -1;
+	mandelbrot_setDisplay(0);
+	printf("\rServeur en écoute sur \"%s\"    \n", address);
+	fflush(stdout);
+
+	running = 1;
+	while (running) {
+		FD_ZERO(&fds);
+		FD_ZERO(&writeFds);
+		FD_SET(listenFd, &fds);
+		FD_SET(notifyPipe[0], &fds);
+		maxFd = listenFd > notifyPipe[0] ? listenFd : notifyPipe[0];
+		for (i = 0; i < SERVER_MAX_CLIENTS; ++i)
+			if (clients[i].fd >= 0) {
+				FD_SET(clients[i].fd, &fds);
+				if (clients[i].outLength > 0)
+					FD_SET(clients[i].fd, &writeFds);
+				if (clients[i].fd > maxFd)
+					maxFd = clients[i].fd;
+			}
+		if (select(maxFd + 1, &fds, &writeFds, NULL, NULL) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (FD_ISSET(notifyPipe[0], &fds))
+			read_notifications();
+		if (FD_ISSET(listenFd, &fds))
+			accept_client();
+		for (i = 0; i < SERVER_MAX_CLIENTS && running; ++i) {
+			if (clients[i].fd >= 0 && FD_ISSET(clients[i].fd, &writeFds))
+				flush_client(&clients[i]);
+			if (clients[i].fd >= 0 && FD_ISSET(clients[i].fd, &fds))
+				read_client(&clients[i]);
+			if (clients[i].fd >= 0 && clients[i].broken)
+				close_client(&clients[i]);
+		}
+	}
+
+	// arrêt : les rendus en cours sont annulés
+	for (i = 0; i < SERVER_MAX_CLIENTS; ++i)
+		if (clients[i].fd >= 0)
+			close_client(&clients[i]);
+	while (requests != NULL) {
+		mandelbrot_wait(&requests->job);
+		read_notifications();
+	}
+	close(notifyPipe[0]);
+	close(notifyPipe[1]);
+	close(listenFd);
+	if (strspn(address, "0123456789") != strlen(address))
+		unlink(address);
+	mandelbrot_setDisplay(1);
+}
+
+#endif
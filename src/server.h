@@ -0,0 +1,21 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+/* Mode serveur : rendus à la demande via une socket locale */
+
+/* Ecoute sur address (numéro de port TCP sur 127.0.0.1, ou chemin d'une socket
+   unix) et sert les requêtes jusqu'à la commande quit. Une commande par ligne :
+   - render id priorite largeur hauteur xmin xmax ymin ymax initRe initIm
+            julia nbMaxIt raw|rle
+     Réponse à la fin du rendu : "ok id largeur hauteur raw|rle taille\n" suivi
+     de taille octets. raw : pixels 0x00RRGGBB (ordre des octets de la machine)
+     ligne par ligne ; rle : couples (nombre, pixel) d'entiers 32 bits.
+     Les requêtes de plus forte priorité sont rendues en premier, les
+     requêtes identiques en cours sont regroupées en un seul rendu.
+   - cancel id : annule la requête id du client, réponse "cancelled id\n"
+   - quit : arrête le serveur
+   Les erreurs sont signalées par "error id message\n".
+   Le moteur doit être initialisé (mandelbrot_init) */
+void server_run(const char *address);
+
+#endif
@@ -0,0 +1,173 @@
+#include <math.h>
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mandelbrot.h"
+#include "options.h"
+#include "sweep.h"
+
+#define COLOR_DEPTH 32                // couleurs 32 bits
+#define SWEEP_MAX_INFLIGHT 16         // nombre max d'images rendues ensemble
+#define LINE_MAX_LENGTH 2048
+
+/*********************************************/
+/*******    VARIABLES DU MODULE    ***********/
+/*********************************************/
+
+/* Chemin de c : cercle ou images clés */
+static int circle;
+static struct complex center;
+static double radius;
+static struct complex *keys;
+static int nbKeys;
+
+/* Images en cours de rendu, l'image num occupe l'emplacement num % nbSlots */
+static struct mandelbrot_job jobs[SWEEP_MAX_INFLIGHT];
+static SDL_Surface *surfaces[SWEEP_MAX_INFLIGHT];
+static int nbSlots;
+
+/*********************************************/
+/*******           CHEMIN          ***********/
+/*********************************************/
+
+/* Lit les images clés du fichier fileName */
+static void read_keys(const char *fileName)
+{
+	char line[LINE_MAX_LENGTH];
+	struct complex c;
+	int lineNum = 0;
+	FILE *file = fopen(fileName, "r");
+	if (file == NULL) {
+		printf("\nImpossible d'ouvrir le fichier \"%s\"\n", fileName); exit(EXIT_FAILURE);
+	}
+	nbKeys = 0;
+	while (fgets(line, LINE_MAX_LENGTH, file) != NULL) {
+		++lineNum;
+		if (line[strspn(line, " \t\r\n")] == '\0' || line[0] == '#')
+			continue;
+		if (sscanf(line, "%lf %lf", &c.real, &c.im) != 2) {
+			printf("\nLigne %d incorrecte, ignorée\n", lineNum);
+			continue;
+		}
+		keys = (struct complex*) realloc(keys, (nbKeys+1) * sizeof(struct complex));
+		keys[nbKeys++] = c;
+	}
+	fclose(file);
+	if (nbKeys == 0) {
+		printf("\nAucune image clé dans \"%s\"\n", fileName); exit(EXIT_FAILURE);
+	}
+}
+
+/* Lit le chemin : cercle ou fichier d'images clés */
+static void read_path(const char *path)
+{
+	circle = (strncmp(path, "circle:", 7) == 0);
+	if (!circle) {
+		read_keys(path);
+	} else if (sscanf(path + 7, "%lf,%lf,%lf", &center.real, &center.im, &radius) != 3) {
+		printf("\nChemin incorrect : \"%s\"\n", path); exit(EXIT_FAILURE);
+	}
+}
+
+/* Image clé i, les extrémités étant prolongées */
+static struct complex key(int i)
+{
+	return keys[i < 0 ? 0 : (i >= nbKeys ? nbKeys-1 : i)];
+}
+
+/* Valeur de c pour l'image num sur nbFrames */
+static struct complex path_point(int num, int nbFrames)
+{
+	struct complex c, p0, p1, p2, p3;
+	double t, t2, t3;
+	int seg;
+	if (circle) {
+		t = 2*M_PI * num / nbFrames;
+		c.real = center.real + radius*cos(t);
+		c.im = center.im + radius*sin(t);
+		return c;
+	}
+	// paramètre dans [0, nbKeys-1] : segment seg, position t dans le segment
+	t = (nbFrames > 1) ? (double) num * (nbKeys-1) / (nbFrames-1) : 0;
+	seg = (int) t;
+	if (seg >= nbKeys-1)
+		return key(nbKeys-1);
+	t -= seg;
+	t2 = t*t;
+	t3 = t2*t;
+	p0 = key(seg-1); p1 = key(seg); p2 = key(seg+1); p3 = key(seg+2);
+	c.real = 0.5 * (2*p1.real + (p2.real - p0.real)*t 
+			+ (2*p0.real - 5*p1.real + 4*p2.real - p3.real)*t2
+			+ (3*p1.real - p0.real - 3*p2.real + p3.real)*t3);
+	c.im = 0.5 * (2*p1.im + (p2.im - p0.im)*t 
+			+ (2*p0.im - 5*p1.im + 4*p2.im - p3.im)*t2
+			+ (3*p1.im - p0.im - 3*p2.im + p3.im)*t3);
+	return c;
+}
+
+/*********************************************/
+/*******           RENDU           ***********/
+/*********************************************/
+
+/* Soumet l'image num dans son emplacement : les images précédentes sont 
+   prioritaires, leurs lignes sont distribuées avant celles de num */
+static void submit(int num, int nbFrames, struct bounds bounds, int nbMaxIt)
+{
+	struct mandelbrot_job *job = &jobs[num % nbSlots];
+	mandelbrot_initJob(job, bounds, path_point(num, nbFrames), 1, nbMaxIt, 
+			surfaces[num % nbSlots]);
+	job->formula = options_getFormula();
+	job->power = options_getPower();
+	job->symmetry = options_getSymmetry();
+	job->priority = -num;
+	mandelbrot_submit(job);
+}
+
+/*********************************************/
+/*******       PUBLIC FUNCTIONS    ***********/
+/*********************************************/
+
+void sweep_run(const char *path, int nbFrames, struct bounds _bounds, 
+		int _nbMaxIt, struct dimension _dim, const char *name)
+{
+	char fileName[1024+16];
+	int i, num;
+
+	read_path(path);
+
+	// assez d'images en vol pour que chaque thread ait des lignes à calculer,
+	// même quand l'image la plus ancienne n'en a plus à distribuer
+	nbSlots = 2 + mandelbrot_getNbThreads() / _dim.height;
+	if (nbSlots > SWEEP_MAX_INFLIGHT)
+		nbSlots = SWEEP_MAX_INFLIGHT;
+	if (nbSlots > nbFrames)
+		nbSlots = nbFrames;
+	for (i = 0; i < nbSlots; ++i) {
+		surfaces[i] = SDL_CreateRGBSurface(0, _dim.width, _dim.height, COLOR_DEPTH, 0, 0, 0, 0);
+		if (surfaces[i] == NULL) {
+			printf("\nImpossible d'obtenir une surface graphique\n"); exit(EXIT_FAILURE);
+		}
+	}
+
+	mandelbrot_setDisplay(0);
+	for (num = 0; num < nbSlots; ++num)
+		submit(num, nbFrames, _bounds, _nbMaxIt);
+	for (num = 0; num < nbFrames; ++num) {
+		printf("\rGénération des images en cours... %2.1f %%    ", 
+				(double) (num*100)/nbFrames);
+		fflush(stdout);
+		mandelbrot_wait(&jobs[num % nbSlots]);
+		sprintf(fileName, "%s%i.bmp", name, num);
+		SDL_SaveBMP(surfaces[num % nbSlots], fileName);
+		if (num + nbSlots < nbFrames)
+			submit(num + nbSlots, nbFrames, _bounds, _nbMaxIt);
+	}
+	mandelbrot_setDisplay(1);
+
+	for (i = 0; i < nbSlots; ++i)
+		SDL_FreeSurface(surfaces[i]);
+	free(keys);
+	keys = NULL;
+}
@@ -0,0 +1,22 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "types.h"
+
+/* Mode balayage : animation de l'ensemble de Julia dont le paramètre c suit
+   un chemin */
+
+/* Génère nbFrames images (name%num.bmp) de l'ensemble de Julia sur _bounds,
+   c parcourant le chemin décrit par path :
+   - "circle:re,im,r" : cercle de centre re + i*im et de rayon r, parcouru une
+     fois (la dernière image précède le retour au point de départ)
+   - sinon, fichier d'images clés : un complexe "re im" par ligne (lignes
+     vides et commençant par # ignorées), interpolées par une spline de
+     Catmull-Rom passant par chacune d'elles, de la première à la dernière
+   Plusieurs images sont rendues en même temps par le moteur (les premières
+   en priorité) et sauvegardées dans l'ordre dès qu'elles sont terminées.
+   Le moteur doit être initialisé (mandelbrot_init) */
+void sweep_run(const char *path, int nbFrames, struct bounds _bounds, 
+		int _nbMaxIt, struct dimension _dim, const char *name);
+
+#endif
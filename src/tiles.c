@@ -0,0 +1,240 @@
+#include <errno.h>
+#include <SDL/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "mandelbrot.h"
+#include "tiles.h"
+
+#define COLOR_DEPTH 32            // couleurs 32 bits
+#define HALF_TILE (TILE_SIZE/2)
+
+// Compilation conditionnelle car mkdir n'a pas la même signature sous windows
+#ifdef WIN32
+#include <direct.h>
+#define MAKE_DIR(path) _mkdir(path)
+#else
+#define MAKE_DIR(path) mkdir(path, 0755)
+#endif
+
+/*********************************************/
+/*******    VARIABLES DU MODULE    ***********/
+/*********************************************/
+
+/* Paramètres de la pyramide */
+static struct bounds bounds;      // bornes (carrées) de la tuile 0/0/0
+static struct complex init;       // z0 (Mandelbrot) ou c (Julia)
+static int nbMaxIt;               // nombre iterations max par point
+static int julia;                 // Julia (1) ou Mandelbrot (0) ?
+static int formula, power;        // formule itérée (MANDELBROT_FORMULA_*)
+static double symmetry;           // tolérance de la symétrie (< 0 : désactivée)
+static int maxZoom;               // niveau le plus fin
+static const char *root;          // répertoire racine
+
+/* Surfaces de travail */
+static SDL_Surface *tile;         // rendu d'une tuile du niveau le plus fin
+static SDL_Surface **parents;     // parents[z] : tuile du niveau z en cours d'assemblage
+
+/* Avancement */
+static long nbTiles, doneTiles;
+static long writtenTiles;           // tuiles calculées ou assemblées
+static long reusedTiles;           // tuiles existantes chargées (sans leur sous-arbre)
+
+/*********************************************/
+/*******          UTILITAIRES      ***********/
+/*********************************************/
+
+/* Crée un répertoire s'il n'existe pas déjà */
+static void make_dir(const char *path)
+{
+	if (MAKE_DIR(path) != 0 && errno != EEXIST) {
+		printf("\nImpossible de créer le répertoire \"%s\"\n", path); exit(EXIT_FAILURE);
+	}
+}
+
+static SDL_Surface *create_tile()
+{
+	SDL_Surface *s = SDL_CreateRGBSurface(0, TILE_SIZE, TILE_SIZE, COLOR_DEPTH, 0, 0, 0, 0);
+	if (s == NULL) {
+		printf("\nImpossible d'obtenir une surface graphique\n"); exit(EXIT_FAILURE);
+	}
+	return s;
+}
+
+/* Charge une tuile existante au format des surfaces de travail, NULL si absente */
+static SDL_Surface *load_tile(const char *name)
+{
+	SDL_Surface *loaded, *converted;
+	loaded = SDL_LoadBMP(name);
+	if (loaded == NULL)
+		return NULL;
+	if (loaded->w != TILE_SIZE || loaded->h != TILE_SIZE) {
+		SDL_FreeSurface(loaded);
+		return NULL; // tuile d'une autre pyramide : on la recalcule
+	}
+	converted = SDL_ConvertSurface(loaded, tile->format, SDL_SWSURFACE);
+	SDL_FreeSurface(loaded);
+	return converted;
+}
+
+/* Sauvegarde une tuile (fichier temporaire puis renommage : une interruption
+   pendant l'écriture ne laisse pas de tuile tronquée, que la reprise 
+   prendrait pour complète) */
+static void save_tile(SDL_Surface *s, const char *name)
+{
+	char tmp[1024+8];
+	int ok;
+	sprintf(tmp, "%s.tmp", name);
+	ok = SDL_SaveBMP(s, tmp) == 0;
+#ifdef WIN32
+	if (ok)
+		remove(name);
+#endif
+	if (!ok || rename(tmp, name) != 0) {
+		remove(tmp);
+		printf("\nImpossible d'écrire la tuile \"%s\"\n", name); exit(EXIT_FAILURE);
+	}
+}
+
+/* Copie un pixel sur deux de src dans le quart (qx, qy) de dst
+   Le point calculé pour le pixel (i, j) d'une tuile est son coin
+   haut-gauche : le pixel (2i, 2j) de l'enfant tombe exactement dessus */
+static void decimate(SDL_Surface *src, SDL_Surface *dst, int qx, int qy)
+{
+	int i, j;
+	Uint32 *in, *out;
+	for (j = 0; j < HALF_TILE; ++j) {
+		in = (Uint32*) src->pixels + 2*j*(src->pitch/4);
+		out = (Uint32*) dst->pixels + (qy*HALF_TILE + j)*(dst->pitch/4) + qx*HALF_TILE;
+		for (i = 0; i < HALF_TILE; ++i)
+			out[i] = in[2*i];
+	}
+}
+
+/*********************************************/
+/*******           PYRAMIDE        ***********/
+/*********************************************/
+
+static void progress()
+{
+	++doneTiles;
+	printf("\rGénération des tuiles en cours... %2.1f %%    ",
+			(double) (doneTiles*100)/nbTiles);
+	fflush(stdout);
+}
+
+/* Bornes de la tuile (z, x, y) */
+static struct bounds tile_bounds(int z, int x, int y)
+{
+	struct bounds b;
+	const double w = (bounds.xmax - bounds.xmin) / (1 << z);
+	const double h = (bounds.ymax - bounds.ymin) / (1 << z);
+	b.xmin = bounds.xmin + x*w;
+	b.xmax = b.xmin + w;
+	b.ymin = bounds.ymin + y*h;
+	b.ymax = b.ymin + h;
+	return b;
+}
+
+/* Produit la tuile (z, x, y) et la reporte dans son parent
+   Une tuile n'est écrite qu'une fois tous ses descendants écrits :
+   si elle existe déjà, son sous-arbre est supposé complet et n'est pas 
+   parcouru (des descendants supprimés depuis ne sont pas régénérés) */
+static void build(int z, int x, int y)
+{
+	char name[1024];
+	SDL_Surface *src, *loaded;
+	struct mandelbrot_job job;
+	long subtree;
+	int i;
+
+	sprintf(name, "%s/%d/%d/%d.bmp", root, z, x, y);
+	loaded = load_tile(name);
+	if (loaded != NULL) {
+		src = loaded;
+		for (i = z, subtree = 0; i <= maxZoom; ++i)
+			subtree += 1L << 2*(i-z);
+		doneTiles += subtree - 1;
+		++reusedTiles;
+	} else {
+		if (z == maxZoom) {
+			src = tile;
+			mandelbrot_initJob(&job, tile_bounds(z, x, y), init, julia, nbMaxIt, tile);
+			job.formula = formula;
+			job.power = power;
+			job.symmetry = symmetry;
+			mandelbrot_renderJobs(&job, 1);
+		} else {
+			src = parents[z];
+			build(z+1, 2*x, 2*y);
+			build(z+1, 2*x+1, 2*y);
+			build(z+1, 2*x, 2*y+1);
+			build(z+1, 2*x+1, 2*y+1);
+		}
+		sprintf(name, "%s/%d/%d", root, z, x);
+		make_dir(name);
+		sprintf(name, "%s/%d/%d/%d.bmp", root, z, x, y);
+		save_tile(src, name);
+		++writtenTiles;
+	}
+	progress();
+
+	if (z > 0)
+		decimate(src, parents[z-1], x & 1, y & 1);
+	if (loaded != NULL)
+		SDL_FreeSurface(loaded);
+}
+
+/*********************************************/
+/*******       PUBLIC FUNCTIONS    ***********/
+/*********************************************/
+
+void tiles_generate(struct bounds _bounds, struct complex _init, int _julia,
+		int _nbMaxIt, int _formula, int _power, double _symmetry, int _maxZoom,
+		const char *_root)
+{
+	char name[1024];
+	int z;
+
+	// Bornes étendues à un carré de même centre
+	const double cx = (_bounds.xmax + _bounds.xmin) / 2;
+	const double cy = (_bounds.ymax + _bounds.ymin) / 2;
+	double half = (_bounds.xmax - _bounds.xmin) / 2;
+	if ((_bounds.ymax - _bounds.ymin) / 2 > half)
+		half = (_bounds.ymax - _bounds.ymin) / 2;
+	bounds.xmin = cx - half; bounds.xmax = cx + half;
+	bounds.ymin = cy - half; bounds.ymax = cy + half;
+
+	init = _init;
+	julia = _julia;
+	nbMaxIt = _nbMaxIt;
+	formula = _formula;
+	power = _power;
+	symmetry = _symmetry;
+	maxZoom = _maxZoom;
+	root = _root;
+
+	tile = create_tile();
+	parents = (SDL_Surface**) malloc((maxZoom+1) * sizeof(SDL_Surface*));
+	make_dir(root);
+	for (z = 0; z <= maxZoom; ++z) {
+		parents[z] = (z < maxZoom) ? create_tile() : NULL;
+		sprintf(name, "%s/%d", root, z);
+		make_dir(name);
+	}
+
+	nbTiles = ((1L << 2*(maxZoom+1)) - 1) / 3;
+	doneTiles = writtenTiles = reusedTiles = 0;
+	mandelbrot_setDisplay(0);
+	build(0, 0, 0);
+	mandelbrot_setDisplay(1);
+	printf("\r%ld tuiles écrites dans \"%s\", %ld tuiles existantes reprises avec leur sous-arbre    ",
+			writtenTiles, root, reusedTiles);
+
+	for (z = 0; z < maxZoom; ++z)
+		SDL_FreeSurface(parents[z]);
+	free(parents);
+	SDL_FreeSurface(tile);
+}
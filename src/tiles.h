@@ -0,0 +1,25 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include "types.h"
+
+#define TILE_SIZE 256             // tuiles carrées de 256 pixels
+
+/* Générateur de pyramide de tuiles (z/x/y) pour les visualiseurs web */
+
+/* Génère toutes les tuiles des niveaux 0 à maxZoom dans root/z/x/y.bmp
+   - _bounds : bornes de l'espace (étendues à un carré de même centre)
+   - _init, _julia, _nbMaxIt : voir mandelbrot_render
+   - _formula, _power, _symmetry : formule itérée et tolérance de la 
+     symétrie (voir struct mandelbrot_job)
+   - maxZoom : niveau le plus fin (2^maxZoom tuiles par côté)
+   - root : répertoire racine de la pyramide
+   Seul le niveau le plus fin est calculé, les niveaux parents sont obtenus
+   par décimation exacte de leurs quatre enfants. Les tuiles déjà présentes
+   sont réutilisées : un rendu interrompu reprend là où il s'est arrêté.
+   Le moteur doit être initialisé (mandelbrot_init) */
+void tiles_generate(struct bounds _bounds, struct complex _init, int _julia,
+		int _nbMaxIt, int _formula, int _power, double _symmetry, int maxZoom,
+		const char *root);
+
+#endif